@@ -0,0 +1,234 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Arena.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: Arena
+// Bump allocator for everything a single conversion job needs. Nothing is
+// freed on its own; Reset() releases the whole job at once and keeps one block
+// big enough for the largest job seen, so a batch stops touching the heap once
+// it has warmed up.
+////////////////////////////////////////////////////////////////////////////////
+class Arena
+{
+private:
+	struct Block
+	{
+		Block* next;
+		size_t size;
+		size_t used;
+	};
+
+	struct Cleanup
+	{
+		Cleanup* next;
+		void(*destroy)(void*, size_t);
+		void* ptr;
+		size_t count;
+	};
+
+public:
+	Arena(size_t blockSize = 1 << 20)
+	{
+		m_blocks = 0;
+		m_cleanups = 0;
+		m_blockSize = blockSize;
+		m_used = 0;
+		m_highWater = 0;
+		m_reserved = 0;
+		m_blockAllocs = 0;
+		m_allocs = 0;
+	}
+
+	~Arena()
+	{
+		Reset();
+		FreeBlocks();
+	}
+
+	// Returns uninitialized memory, or 0 if the system is out of memory.
+	void* Alloc(size_t size, size_t align = 16)
+	{
+		if (!m_blocks || !Fits(m_blocks, size, align))
+		{
+			if (!NewBlock(size + align))
+			{
+				return 0;
+			}
+		}
+
+		m_allocs++;
+
+		Block* block = m_blocks;
+		size_t start = Align((size_t)(block + 1) + block->used, align) - (size_t)(block + 1);
+		m_used += start + size - block->used;
+		block->used = start + size;
+
+		if (m_used > m_highWater)
+		{
+			m_highWater = m_used;
+		}
+
+		return (char*)(block + 1) + start;
+	}
+
+	// Allocates and default initializes count objects. Types that need their
+	// destructor run are recorded so Reset() can destroy them.
+	template <class T>
+	T* NewArray(size_t count)
+	{
+		// A count read from a file must not wrap the size to a small block.
+		if (count > SIZE_MAX / sizeof(T))
+		{
+			return 0;
+		}
+
+		T* ptr = (T*)Alloc(sizeof(T) * (count ? count : 1), alignof(T) > 16 ? alignof(T) : 16);
+		if (!ptr)
+		{
+			return 0;
+		}
+
+		if (!std::is_trivially_default_constructible<T>::value)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				new (&ptr[i]) T;
+			}
+		}
+
+		if (!std::is_trivially_destructible<T>::value)
+		{
+			Cleanup* cleanup = (Cleanup*)Alloc(sizeof(Cleanup), alignof(Cleanup));
+			if (!cleanup)
+			{
+				return 0;
+			}
+			cleanup->destroy = &DestroyArray<T>;
+			cleanup->ptr = ptr;
+			cleanup->count = count;
+			cleanup->next = m_cleanups;
+			m_cleanups = cleanup;
+		}
+
+		return ptr;
+	}
+
+	// Releases everything allocated since the last reset.
+	void Reset()
+	{
+		// Destroy in reverse order of construction.
+		while (m_cleanups)
+		{
+			m_cleanups->destroy(m_cleanups->ptr, m_cleanups->count);
+			m_cleanups = m_cleanups->next;
+		}
+
+		// A job that spilled into several blocks gets one block that fits it next time.
+		if (m_blocks && m_blocks->next)
+		{
+			FreeBlocks();
+			NewBlock(m_highWater + m_highWater / 8);
+		}
+
+		if (m_blocks)
+		{
+			m_blocks->used = 0;
+		}
+		m_used = 0;
+	}
+
+	// Bytes handed out since the last reset.
+	size_t Used() const { return m_used; }
+
+	// Most bytes handed out between two resets.
+	size_t HighWater() const { return m_highWater; }
+
+	// Bytes currently held from the system.
+	size_t Reserved() const { return m_reserved; }
+
+	// Number of times a block had to be taken from the system.
+	size_t BlockAllocations() const { return m_blockAllocs; }
+
+	// Number of Alloc() calls over the arena's lifetime.
+	size_t AllocationCount() const { return m_allocs; }
+
+private:
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+
+	static size_t Align(size_t value, size_t align)
+	{
+		return (value + align - 1) & ~(align - 1);
+	}
+
+	static bool Fits(Block* block, size_t size, size_t align)
+	{
+		size_t start = Align((size_t)(block + 1) + block->used, align) - (size_t)(block + 1);
+		return start + size <= block->size;
+	}
+
+	bool NewBlock(size_t minSize)
+	{
+		size_t size = minSize > m_blockSize ? minSize : m_blockSize;
+		Block* block = (Block*)malloc(sizeof(Block) + size);
+		if (!block)
+		{
+			return false;
+		}
+
+		block->next = m_blocks;
+		block->size = size;
+		block->used = 0;
+		m_blocks = block;
+		m_reserved += size;
+		m_blockAllocs++;
+
+		return true;
+	}
+
+	void FreeBlocks()
+	{
+		while (m_blocks)
+		{
+			Block* next = m_blocks->next;
+			free(m_blocks);
+			m_blocks = next;
+		}
+		m_reserved = 0;
+	}
+
+	template <class T>
+	static void DestroyArray(void* ptr, size_t count)
+	{
+		for (size_t i = count; i > 0; i--)
+		{
+			((T*)ptr)[i - 1].~T();
+		}
+	}
+
+private:
+	Block* m_blocks;
+	Cleanup* m_cleanups;
+	size_t m_blockSize;
+	size_t m_used;
+	size_t m_highWater;
+	size_t m_reserved;
+	size_t m_blockAllocs;
+	size_t m_allocs;
+};
+
+#endif
@@ -0,0 +1,512 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Benchmark.cpp
+// Times every conversion stage on synthetic OBJ and M3D models from a
+// thousand up to tens of millions of faces, plus any model files named on the
+// command line. One JSON object is printed per stage so runs can be compared.
+//
+// Usage: ModelBenchmark [--max-faces N] [--repeat N] [model files...]
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "ModelParser.h"
+#include "MemoryStream.h"
+#include "SMFStreamLoader.h"
+using namespace std;
+
+
+//////////////
+// TYPEDEFS //
+//////////////
+struct BenchCase
+{
+	string name;
+	string format;
+	unsigned long long faces;
+	const char* data;
+	size_t size;
+	string directory;
+};
+
+struct StageResult
+{
+	double seconds;
+	unsigned long long bytes;
+	unsigned long long faces;
+};
+
+
+/////////////
+// GLOBALS //
+/////////////
+Arena g_BenchArena;
+int g_Repeat = 3;
+
+
+/////////////////////////
+// FUNCTION PROTOTYPES //
+/////////////////////////
+string GenerateOBJ(unsigned long long, bool, bool);
+string GenerateM3D(unsigned long long, bool);
+bool RunCase(const BenchCase&);
+void PrintStage(const BenchCase&, const char*, const StageResult&);
+
+
+double Now()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+int main(int argc, char* argv[])
+{
+	unsigned long long maxFaces = 1000000;
+	vector<string> files;
+	bool result = true;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--max-faces") == 0 && i + 1 < argc)
+		{
+			maxFaces = strtoull(argv[++i], 0, 10);
+		}
+		else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+		{
+			g_Repeat = atoi(argv[++i]);
+			if (g_Repeat < 1)
+			{
+				g_Repeat = 1;
+			}
+		}
+		else
+		{
+			files.push_back(argv[i]);
+		}
+	}
+
+	// Synthetic models, growing tenfold from a thousand faces.
+	for (unsigned long long faces = 1000; faces <= maxFaces; faces *= 10)
+	{
+		for (int variant = 0; variant < 4; variant++)
+		{
+			bool quads = (variant & 1) != 0;
+			bool groups = (variant & 2) != 0;
+
+			string text = GenerateOBJ(faces, quads, groups);
+			BenchCase obj;
+			obj.name = string("synthetic_") + (quads ? "quads" : "tris") + (groups ? "_groups" : "");
+			obj.format = "obj";
+			obj.faces = faces;
+			obj.data = text.c_str();
+			obj.size = text.size();
+			result &= RunCase(obj);
+		}
+
+		// M3D only stores triangles.
+		for (int groups = 0; groups < 2; groups++)
+		{
+			string text = GenerateM3D(faces, groups != 0);
+			BenchCase m3d;
+			m3d.name = string("synthetic_tris") + (groups ? "_groups" : "");
+			m3d.format = "m3d";
+			m3d.faces = faces;
+			m3d.data = text.c_str();
+			m3d.size = text.size();
+			result &= RunCase(m3d);
+		}
+	}
+
+	// Real models, such as the bundled soldier.m3d and quad.m3d.
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		ifstream fin(files[i].c_str(), ios_base::binary);
+		if (fin.fail())
+		{
+			cerr << "File " << files[i] << " could not be opened." << endl;
+			result = false;
+			continue;
+		}
+
+		stringstream buffer;
+		buffer << fin.rdbuf();
+		string text = buffer.str();
+
+		BenchCase file;
+		file.name = files[i];
+		file.format = GetExtension(files[i]);
+		file.faces = 0;
+		file.data = text.c_str();
+		file.size = text.size();
+		file.directory = GetDirectory(files[i]);
+		result &= RunCase(file);
+	}
+
+	return result ? 0 : -1;
+}
+
+
+string GenerateOBJ(unsigned long long faces, bool quads, bool groups)
+{
+	// A square grid of cells, each cell one quad or two triangles.
+	unsigned long long cells = quads ? faces : (faces + 1) / 2;
+	unsigned long long side = 1;
+	while (side * side < cells)
+	{
+		side++;
+	}
+	unsigned long long rowLength = side + 1;
+	const int groupCount = 16;
+
+	string out;
+	out.reserve((size_t)(faces * (quads ? 40 : 32) + rowLength * rowLength * 48));
+	char line[160];
+
+	for (unsigned long long y = 0; y <= side; y++)
+	{
+		for (unsigned long long x = 0; x <= side; x++)
+		{
+			snprintf(line, sizeof(line), "v %.6f %.6f 0.000000\n", (double)x / side, (double)y / side);
+			out += line;
+		}
+	}
+	for (unsigned long long y = 0; y <= side; y++)
+	{
+		for (unsigned long long x = 0; x <= side; x++)
+		{
+			snprintf(line, sizeof(line), "vt %.6f %.6f\n", (double)x / side, (double)y / side);
+			out += line;
+		}
+	}
+	out += "vn 0.000000 0.000000 1.000000\n";
+
+	if (!groups)
+	{
+		out += "o mesh\n";
+	}
+
+	unsigned long long written = 0;
+	for (unsigned long long c = 0; written < faces; c++)
+	{
+		if (groups && c % ((cells + groupCount - 1) / groupCount) == 0)
+		{
+			snprintf(line, sizeof(line), "g part%llu\n", c / ((cells + groupCount - 1) / groupCount));
+			out += line;
+		}
+
+		unsigned long long a = (c / side) * rowLength + c % side + 1;
+		unsigned long long b = a + 1;
+		unsigned long long d = a + rowLength;
+		unsigned long long e = d + 1;
+
+		if (quads)
+		{
+			snprintf(line, sizeof(line), "f %llu/%llu/1 %llu/%llu/1 %llu/%llu/1 %llu/%llu/1\n", a, a, b, b, e, e, d, d);
+			out += line;
+			written++;
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "f %llu/%llu/1 %llu/%llu/1 %llu/%llu/1\n", a, a, b, b, e, e);
+			out += line;
+			written++;
+			if (written < faces)
+			{
+				snprintf(line, sizeof(line), "f %llu/%llu/1 %llu/%llu/1 %llu/%llu/1\n", a, a, e, e, d, d);
+				out += line;
+				written++;
+			}
+		}
+	}
+
+	return out;
+}
+
+
+string GenerateM3D(unsigned long long faces, bool groups)
+{
+	// Every triangle gets its own three vertices so subsets split cleanly.
+	unsigned long long subsets = groups ? 16 : 1;
+	if (subsets > faces)
+	{
+		subsets = faces;
+	}
+	unsigned long long vertices = faces * 3;
+
+	string out;
+	out.reserve((size_t)(vertices * 200 + faces * 24));
+	char line[256];
+
+	out += "***************m3d-File-Header***************\n";
+	snprintf(line, sizeof(line), "#Materials %llu\n#Vertices %llu\n#Triangles %llu\n#Bones 0\n#AnimationClips 0\n\n", subsets, vertices, faces);
+	out += line;
+
+	out += "***************Materials*********************\n";
+	for (unsigned long long i = 0; i < subsets; i++)
+	{
+		snprintf(line, sizeof(line), "Ambient: 1 1 1\nDiffuse: 1 1 1\nSpecular: 0.5 0.5 0.5\nSpecPower: 1.245731\nReflectivity: 0 0 0\nAlphaClip: 0\nEffect: Basic\nDiffuseMap: part%llu_diff.jpg\nNormalMap: part%llu_norm.jpg\n\n", i, i);
+		out += line;
+	}
+
+	out += "***************SubsetTable*******************\n";
+	unsigned long long faceStart = 0;
+	for (unsigned long long i = 0; i < subsets; i++)
+	{
+		unsigned long long count = faces / subsets + (i < faces % subsets ? 1 : 0);
+		snprintf(line, sizeof(line), "SubsetID: %llu VertexStart: %llu VertexCount: %llu FaceStart: %llu FaceCount: %llu\n", i, faceStart * 3, count * 3, faceStart, count);
+		out += line;
+		faceStart += count;
+	}
+	out += "\n";
+
+	out += "***************Vertices**********************\n";
+	for (unsigned long long v = 0; v < vertices; v++)
+	{
+		float x = (float)(v % 1024) / 1024.0f;
+		float y = (float)(v / 1024 % 1024) / 1024.0f;
+		snprintf(line, sizeof(line), "Position: %g %g %g\nTangent: 1 0 0 1\nNormal: 0 0 -1\nTex-Coords: %g %g\nBlendWeights: 1 0 0 0\nBlendIndices: 0 0 0 0\n\n", x, y, (float)(v % 3), x, y);
+		out += line;
+	}
+	out += "\n";
+
+	out += "***************Triangles*********************\n";
+	for (unsigned long long f = 0; f < faces; f++)
+	{
+		snprintf(line, sizeof(line), "%llu %llu %llu\n", f * 3, f * 3 + 1, f * 3 + 2);
+		out += line;
+	}
+	out += "\n";
+
+	return out;
+}
+
+
+// Fastest time from starting a streaming load to its first range.
+struct StreamProbe
+{
+	double start;
+	double first;
+	bool seen;
+};
+
+
+void FirstRange(const SMFView&, const SubsetTableDesc&, void* user)
+{
+	StreamProbe* probe = (StreamProbe*)user;
+	if (!probe->seen)
+	{
+		double seconds = Now() - probe->start;
+		probe->first = probe->first < 0.0 || seconds < probe->first ? seconds : probe->first;
+		probe->seen = true;
+	}
+}
+
+
+// Runs one stage g_Repeat times and keeps the fastest run.
+template <class F>
+bool TimeStage(StageResult& best, F stage)
+{
+	best.seconds = -1.0;
+	for (int r = 0; r < g_Repeat; r++)
+	{
+		double start = Now();
+		bool result = stage();
+		double seconds = Now() - start;
+		if (!result)
+		{
+			return false;
+		}
+		if (best.seconds < 0.0 || seconds < best.seconds)
+		{
+			best.seconds = seconds;
+		}
+	}
+	return true;
+}
+
+
+bool RunCase(const BenchCase& c)
+{
+	StageResult stage;
+	Mesh mesh;
+	ObjData obj;
+	unsigned long long faces = c.faces;
+	string tempFile = "ModelBenchmark.tmp.smf";
+
+	g_BenchArena.Reset();
+
+	if (c.format == "obj")
+	{
+		// Count pass.
+		bool result = TimeStage(stage, [&]() {
+			MemoryStream fin(c.data, c.size);
+			return ReadFileCounts(fin, obj.vertexCount, obj.textureCount, obj.normalCount, obj.faceCount, obj.objectCount);
+		});
+		if (!result)
+		{
+			return false;
+		}
+		if (!faces)
+		{
+			faces = obj.faceCount;
+		}
+		stage.bytes = c.size;
+		stage.faces = faces;
+		PrintStage(c, "count", stage);
+
+		// Attribute and face parsing. Each run gets a clean arena.
+		result = TimeStage(stage, [&]() {
+			g_BenchArena.Reset();
+			MemoryStream fin(c.data, c.size);
+			return LoadDataStructures(fin, c.directory, g_BenchArena, obj);
+		});
+		if (!result)
+		{
+			return false;
+		}
+		PrintStage(c, "parse", stage);
+
+		// Normals for the faces that have none, kept for the expansion. Every
+		// run allocates anew, so the bytes are those of a single run.
+		if (obj.missingNormals)
+		{
+			result = TimeStage(stage, [&]() {
+				size_t mark = g_BenchArena.Used();
+				bool generated = GenerateNormals(obj, g_BenchArena);
+				stage.bytes = g_BenchArena.Used() - mark;
+				return generated;
+			});
+			if (!result)
+			{
+				return false;
+			}
+			PrintStage(c, "normals", stage);
+		}
+
+		// Face expansion, without freeing the parsed attributes.
+		result = TimeStage(stage, [&]() {
+			size_t mark = g_BenchArena.Used();
+			bool expanded = ExpandFaces(obj, g_BenchArena, mesh);
+			stage.bytes = g_BenchArena.Used() - mark;
+			return expanded;
+		});
+		if (!result)
+		{
+			return false;
+		}
+		PrintStage(c, "expand", stage);
+	}
+	else if (c.format == "m3d")
+	{
+		bool result = TimeStage(stage, [&]() {
+			g_BenchArena.Reset();
+			MemoryStream fin(c.data, c.size);
+			return M3DReadFileCounts(fin, g_BenchArena, mesh);
+		});
+		if (!result)
+		{
+			return false;
+		}
+		if (!faces)
+		{
+			faces = mesh.IndexCount / 3;
+		}
+		stage.bytes = c.size;
+		stage.faces = faces;
+		PrintStage(c, "parse", stage);
+	}
+	else
+	{
+		cerr << "Unknown format " << c.format << " for " << c.name << endl;
+		return false;
+	}
+
+	// Validation of the parsed mesh. Only the first run can drop anything.
+	bool validated = TimeStage(stage, [&]() {
+		return SanitizeMesh(mesh, g_BenchArena);
+	});
+	if (!validated)
+	{
+		return false;
+	}
+	stage.bytes = sizeof(vertexData) * mesh.VertexCount + sizeof(ULONG) * mesh.IndexCount;
+	PrintStage(c, "validate", stage);
+
+	// .smf write and read back through the loader, plain and packed.
+	static const UINT flags[2] = { 0, SMF_WRITE_COMPRESS };
+	static const char* writeNames[2] = { "smf_write", "smf_write_packed" };
+	static const char* readNames[2] = { "smf_read", "smf_read_packed" };
+	static const char* streamNames[2] = { "smf_stream", "smf_stream_packed" };
+	static const char* firstNames[2] = { "smf_stream_first", "smf_stream_packed_first" };
+	for (int f = 0; f < 2; f++)
+	{
+		bool result = TimeStage(stage, [&]() {
+			return WriteSMF(mesh, tempFile.c_str(), flags[f], &g_BenchArena);
+		});
+		if (!result)
+		{
+			return false;
+		}
+		ifstream written(tempFile.c_str(), ios_base::binary | ios_base::ate);
+		stage.bytes = (unsigned long long)written.tellg();
+		written.close();
+		stage.faces = faces;
+		PrintStage(c, writeNames[f], stage);
+
+		// Read throughput counts the decoded bytes.
+		result = TimeStage(stage, [&]() {
+			SMFView view;
+			return LoadSMF(tempFile.c_str(), g_BenchArena, view);
+		});
+		if (!result)
+		{
+			remove(tempFile.c_str());
+			return false;
+		}
+		stage.bytes = SMFSize(mesh);
+		PrintStage(c, readNames[f], stage);
+
+		// The streaming loader, timed to the first usable range and to the end.
+		StreamProbe probe;
+		probe.first = -1.0;
+		result = TimeStage(stage, [&]() {
+			SMFStreamLoader loader;
+			SMFView view;
+			probe.start = Now();
+			probe.seen = false;
+			return loader.Start(tempFile.c_str(), g_BenchArena) && loader.Finish(FirstRange, &probe, view);
+		});
+		remove(tempFile.c_str());
+		if (!result)
+		{
+			return false;
+		}
+		PrintStage(c, streamNames[f], stage);
+		stage.seconds = probe.first;
+		PrintStage(c, firstNames[f], stage);
+	}
+
+	g_BenchArena.Reset();
+
+	return true;
+}
+
+
+void PrintStage(const BenchCase& c, const char* stage, const StageResult& r)
+{
+	double seconds = r.seconds > 0.0 ? r.seconds : 1e-9;
+
+	printf("{\"case\": \"%s\", \"format\": \"%s\", \"faces\": %llu, \"stage\": \"%s\", \"seconds\": %.6f, \"bytes\": %llu, \"mb_per_s\": %.2f, \"faces_per_s\": %.0f}\n",
+		JsonEscape(c.name).c_str(), c.format.c_str(), r.faces, stage, r.seconds, r.bytes, r.bytes / seconds / 1e6, r.faces / seconds);
+	fflush(stdout);
+}
@@ -0,0 +1,625 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Collision.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <utility>
+#include <vector>
+#include "ModelParser.h"
+#include "Parallel.h"
+using namespace DirectX;
+using namespace std;
+
+
+void DefaultCollisionOptions(CollisionOptions& options)
+{
+	options.MaxHullVertices = 64;
+	options.MaxHulls = 1;
+	options.MinSplitGain = 0.1f;
+}
+
+
+struct HullPoint
+{
+	double x, y, z;
+};
+
+// A triangle of a hull under construction. Outside lists the points above it
+// that no other face has claimed, Farthest the one furthest away.
+struct HullFace
+{
+	UINT v[3];
+	HullPoint n;
+	double d;
+	bool alive;
+	vector<UINT> outside;
+	UINT farthest;
+	double farthestDistance;
+};
+
+// A finished hull, with triangles indexing its own points.
+struct HullResult
+{
+	vector<HullPoint> points;
+	vector<UINT> triangles;
+	double volume;
+};
+
+
+static HullPoint Sub(const HullPoint& a, const HullPoint& b)
+{
+	HullPoint r = { a.x - b.x, a.y - b.y, a.z - b.z };
+	return r;
+}
+
+
+static HullPoint Cross(const HullPoint& a, const HullPoint& b)
+{
+	HullPoint r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	return r;
+}
+
+
+static double Dot(const HullPoint& a, const HullPoint& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+
+static HullFace MakeFace(const vector<HullPoint>& points, UINT a, UINT b, UINT c)
+{
+	HullFace face;
+	face.v[0] = a;
+	face.v[1] = b;
+	face.v[2] = c;
+	face.n = Cross(Sub(points[b], points[a]), Sub(points[c], points[a]));
+	double length = sqrt(Dot(face.n, face.n));
+	if (length > 0.0)
+	{
+		face.n.x /= length;
+		face.n.y /= length;
+		face.n.z /= length;
+	}
+	face.d = Dot(face.n, points[a]);
+	face.alive = true;
+	face.farthest = 0;
+	face.farthestDistance = 0.0;
+	return face;
+}
+
+
+// Hands a point to the first face it lies above. Points above none are inside.
+static void AssignPoint(vector<HullFace>& faces, size_t firstFace, const vector<HullPoint>& points, UINT p, double epsilon)
+{
+	for (size_t f = firstFace; f < faces.size(); f++)
+	{
+		HullFace& face = faces[f];
+		if (!face.alive)
+		{
+			continue;
+		}
+
+		double distance = Dot(face.n, points[p]) - face.d;
+		if (distance > epsilon)
+		{
+			face.outside.push_back(p);
+			if (distance > face.farthestDistance)
+			{
+				face.farthest = p;
+				face.farthestDistance = distance;
+			}
+			return;
+		}
+	}
+}
+
+
+// The hull of points lying in one plane: a polygon from the monotone chain,
+// thinned to the cap by dropping the corners that span the least area, and
+// closed with triangles on both sides.
+static void PlanarHull(const vector<HullPoint>& points, const HullPoint& normal, UINT cap, HullResult& hull)
+{
+	HullPoint axis = fabs(normal.x) < 0.9 ? HullPoint{ 1.0, 0.0, 0.0 } : HullPoint{ 0.0, 1.0, 0.0 };
+	HullPoint u = Cross(normal, axis);
+	HullPoint v = Cross(normal, u);
+
+	vector<pair<pair<double, double>, UINT> > flat(points.size());
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		flat[i] = make_pair(make_pair(Dot(points[i], u), Dot(points[i], v)), (UINT)i);
+	}
+	sort(flat.begin(), flat.end());
+
+	// Andrew's monotone chain, lower then upper half.
+	vector<UINT> chain;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		size_t floor = chain.size();
+		for (size_t k = 0; k < flat.size(); k++)
+		{
+			size_t i = pass == 0 ? k : flat.size() - 1 - k;
+			while (chain.size() >= floor + 2)
+			{
+				const pair<double, double>& a = flat[chain[chain.size() - 2]].first;
+				const pair<double, double>& b = flat[chain[chain.size() - 1]].first;
+				const pair<double, double>& c = flat[i].first;
+				if ((b.first - a.first) * (c.second - a.second) - (b.second - a.second) * (c.first - a.first) > 0.0)
+				{
+					break;
+				}
+				chain.pop_back();
+			}
+			chain.push_back((UINT)i);
+		}
+		chain.pop_back();
+	}
+
+	while (chain.size() > cap && chain.size() > 3)
+	{
+		size_t smallest = 0;
+		double smallestArea = 0.0;
+		for (size_t k = 0; k < chain.size(); k++)
+		{
+			const pair<double, double>& a = flat[chain[(k + chain.size() - 1) % chain.size()]].first;
+			const pair<double, double>& b = flat[chain[k]].first;
+			const pair<double, double>& c = flat[chain[(k + 1) % chain.size()]].first;
+			double area = fabs((b.first - a.first) * (c.second - a.second) - (b.second - a.second) * (c.first - a.first));
+			if (k == 0 || area < smallestArea)
+			{
+				smallest = k;
+				smallestArea = area;
+			}
+		}
+		chain.erase(chain.begin() + smallest);
+	}
+
+	for (size_t k = 0; k < chain.size(); k++)
+	{
+		hull.points.push_back(points[flat[chain[k]].second]);
+	}
+	for (UINT k = 1; k + 1 < (UINT)chain.size(); k++)
+	{
+		UINT front[6] = { 0, k, k + 1, 0, k + 1, k };
+		hull.triangles.insert(hull.triangles.end(), front, front + 6);
+	}
+	hull.volume = 0.0;
+}
+
+
+// Quickhull that stops once the hull has cap vertices. The point furthest
+// outside goes in first, so a capped hull is the best the greedy order finds
+// and lies inside the true one.
+static void BuildHull(const vector<HullPoint>& points, UINT cap, HullResult& hull)
+{
+	hull.points.clear();
+	hull.triangles.clear();
+	hull.volume = 0.0;
+	if (points.empty())
+	{
+		return;
+	}
+
+	// Distances below epsilon are taken as lying on a face.
+	HullPoint lo = points[0], hi = points[0];
+	UINT extreme[6] = { 0, 0, 0, 0, 0, 0 };
+	for (UINT i = 0; i < (UINT)points.size(); i++)
+	{
+		const HullPoint& p = points[i];
+		if (p.x < points[extreme[0]].x) { extreme[0] = i; }
+		if (p.x > points[extreme[1]].x) { extreme[1] = i; }
+		if (p.y < points[extreme[2]].y) { extreme[2] = i; }
+		if (p.y > points[extreme[3]].y) { extreme[3] = i; }
+		if (p.z < points[extreme[4]].z) { extreme[4] = i; }
+		if (p.z > points[extreme[5]].z) { extreme[5] = i; }
+	}
+	lo.x = points[extreme[0]].x; hi.x = points[extreme[1]].x;
+	lo.y = points[extreme[2]].y; hi.y = points[extreme[3]].y;
+	lo.z = points[extreme[4]].z; hi.z = points[extreme[5]].z;
+	double scale = max(max(hi.x - lo.x, hi.y - lo.y), max(hi.z - lo.z, max(max(fabs(lo.x), fabs(hi.x)), max(max(fabs(lo.y), fabs(hi.y)), max(fabs(lo.z), fabs(hi.z))))));
+	double epsilon = scale * 1e-9;
+
+	// The starting tetrahedron: the two extremes furthest apart, the point
+	// furthest from their line and the one furthest from that plane.
+	UINT a = extreme[0], b = extreme[1];
+	double best = -1.0;
+	for (int i = 0; i < 6; i++)
+	{
+		for (int j = i + 1; j < 6; j++)
+		{
+			HullPoint d = Sub(points[extreme[i]], points[extreme[j]]);
+			if (Dot(d, d) > best)
+			{
+				best = Dot(d, d);
+				a = extreme[i];
+				b = extreme[j];
+			}
+		}
+	}
+	if (sqrt(best) <= epsilon)
+	{
+		hull.points.push_back(points[a]);
+		return;
+	}
+
+	HullPoint line = Sub(points[b], points[a]);
+	UINT c = a;
+	best = 0.0;
+	for (UINT i = 0; i < (UINT)points.size(); i++)
+	{
+		HullPoint d = Cross(line, Sub(points[i], points[a]));
+		if (Dot(d, d) > best)
+		{
+			best = Dot(d, d);
+			c = i;
+		}
+	}
+	if (sqrt(best) / sqrt(Dot(line, line)) <= epsilon)
+	{
+		hull.points.push_back(points[a]);
+		hull.points.push_back(points[b]);
+		return;
+	}
+
+	HullFace base = MakeFace(points, a, b, c);
+	UINT d = a;
+	best = 0.0;
+	for (UINT i = 0; i < (UINT)points.size(); i++)
+	{
+		double distance = fabs(Dot(base.n, points[i]) - base.d);
+		if (distance > best)
+		{
+			best = distance;
+			d = i;
+		}
+	}
+	if (best <= epsilon)
+	{
+		PlanarHull(points, base.n, cap, hull);
+		return;
+	}
+
+	// Faces are wound to face away from the inside of the tetrahedron.
+	vector<HullFace> faces;
+	UINT corners[4] = { a, b, c, d };
+	HullPoint center = { 0.0, 0.0, 0.0 };
+	for (int i = 0; i < 4; i++)
+	{
+		center.x += points[corners[i]].x * 0.25;
+		center.y += points[corners[i]].y * 0.25;
+		center.z += points[corners[i]].z * 0.25;
+	}
+	static const int tetrahedron[4][3] = { { 0, 1, 2 }, { 0, 3, 1 }, { 1, 3, 2 }, { 0, 2, 3 } };
+	for (int i = 0; i < 4; i++)
+	{
+		HullFace face = MakeFace(points, corners[tetrahedron[i][0]], corners[tetrahedron[i][1]], corners[tetrahedron[i][2]]);
+		if (Dot(face.n, center) - face.d > 0.0)
+		{
+			face = MakeFace(points, face.v[0], face.v[2], face.v[1]);
+		}
+		faces.push_back(face);
+	}
+
+	for (UINT i = 0; i < (UINT)points.size(); i++)
+	{
+		if (i != a && i != b && i != c && i != d)
+		{
+			AssignPoint(faces, 0, points, i, epsilon);
+		}
+	}
+
+	// Faces using each point. Corners left without faces fell inside.
+	vector<UINT> uses(points.size(), 0);
+	for (int i = 0; i < 4; i++)
+	{
+		uses[corners[i]] = 3;
+	}
+	UINT vertexCount = 4;
+
+	while (vertexCount < cap)
+	{
+		// The furthest outside point of all.
+		size_t from = faces.size();
+		for (size_t f = 0; f < faces.size(); f++)
+		{
+			if (faces[f].alive && !faces[f].outside.empty() &&
+				(from == faces.size() || faces[f].farthestDistance > faces[from].farthestDistance))
+			{
+				from = f;
+			}
+		}
+		if (from == faces.size())
+		{
+			break;
+		}
+		UINT p = faces[from].farthest;
+
+		// Every face the point sees goes; the edges between seen and unseen
+		// faces are the horizon the new faces grow from.
+		set<pair<UINT, UINT> > edges;
+		vector<UINT> orphans;
+		for (size_t f = 0; f < faces.size(); f++)
+		{
+			HullFace& face = faces[f];
+			if (face.alive && Dot(face.n, points[p]) - face.d > epsilon)
+			{
+				face.alive = false;
+				for (int k = 0; k < 3; k++)
+				{
+					edges.insert(make_pair(face.v[k], face.v[(k + 1) % 3]));
+					vertexCount -= --uses[face.v[k]] == 0 ? 1 : 0;
+				}
+				orphans.insert(orphans.end(), face.outside.begin(), face.outside.end());
+				vector<UINT>().swap(face.outside);
+			}
+		}
+
+		size_t firstNew = faces.size();
+		for (set<pair<UINT, UINT> >::const_iterator e = edges.begin(); e != edges.end(); ++e)
+		{
+			if (edges.count(make_pair(e->second, e->first)) == 0)
+			{
+				faces.push_back(MakeFace(points, e->first, e->second, p));
+				vertexCount += uses[e->first]++ == 0 ? 1 : 0;
+				vertexCount += uses[e->second]++ == 0 ? 1 : 0;
+				vertexCount += uses[p]++ == 0 ? 1 : 0;
+			}
+		}
+
+		for (size_t i = 0; i < orphans.size(); i++)
+		{
+			if (orphans[i] != p)
+			{
+				AssignPoint(faces, firstNew, points, orphans[i], epsilon);
+			}
+		}
+	}
+
+	// Keep the live faces, numbering the points they use.
+	vector<UINT> remap(points.size(), ~0u);
+	for (size_t f = 0; f < faces.size(); f++)
+	{
+		const HullFace& face = faces[f];
+		if (!face.alive)
+		{
+			continue;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (remap[face.v[k]] == ~0u)
+			{
+				remap[face.v[k]] = (UINT)hull.points.size();
+				hull.points.push_back(points[face.v[k]]);
+			}
+			hull.triangles.push_back(remap[face.v[k]]);
+		}
+
+		const HullPoint& p0 = points[face.v[0]];
+		hull.volume += Dot(p0, Cross(points[face.v[1]], points[face.v[2]])) / 6.0;
+	}
+}
+
+
+// A piece of a subset: its triangles, by index into the mesh, and their hull.
+struct HullPiece
+{
+	vector<ULONG> triangles;
+	HullResult hull;
+};
+
+
+static void PieceHull(const Mesh& mesh, HullPiece& piece, UINT cap)
+{
+	vector<HullPoint> points;
+	points.reserve(piece.triangles.size() * 3);
+	for (size_t t = 0; t < piece.triangles.size(); t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			const XMFLOAT3& p = mesh.Vertices[mesh.Indices[piece.triangles[t] * 3 + k]].pos;
+			HullPoint point = { p.x, p.y, p.z };
+			points.push_back(point);
+		}
+	}
+
+	BuildHull(points, cap, piece.hull);
+}
+
+
+// Cuts a piece in two across the longest side of its triangles' centers.
+static bool SplitPiece(const Mesh& mesh, const HullPiece& piece, HullPiece& left, HullPiece& right)
+{
+	if (piece.triangles.size() < 2)
+	{
+		return false;
+	}
+
+	vector<HullPoint> centers(piece.triangles.size());
+	HullPoint lo = { 0.0, 0.0, 0.0 }, hi = { 0.0, 0.0, 0.0 };
+	for (size_t t = 0; t < piece.triangles.size(); t++)
+	{
+		HullPoint c = { 0.0, 0.0, 0.0 };
+		for (int k = 0; k < 3; k++)
+		{
+			const XMFLOAT3& p = mesh.Vertices[mesh.Indices[piece.triangles[t] * 3 + k]].pos;
+			c.x += p.x / 3.0;
+			c.y += p.y / 3.0;
+			c.z += p.z / 3.0;
+		}
+		centers[t] = c;
+		if (t == 0)
+		{
+			lo = hi = c;
+		}
+		lo.x = min(lo.x, c.x); hi.x = max(hi.x, c.x);
+		lo.y = min(lo.y, c.y); hi.y = max(hi.y, c.y);
+		lo.z = min(lo.z, c.z); hi.z = max(hi.z, c.z);
+	}
+
+	int axis = hi.x - lo.x >= hi.y - lo.y && hi.x - lo.x >= hi.z - lo.z ? 0 : hi.y - lo.y >= hi.z - lo.z ? 1 : 2;
+	double middle = axis == 0 ? (lo.x + hi.x) * 0.5 : axis == 1 ? (lo.y + hi.y) * 0.5 : (lo.z + hi.z) * 0.5;
+	for (size_t t = 0; t < piece.triangles.size(); t++)
+	{
+		double c = axis == 0 ? centers[t].x : axis == 1 ? centers[t].y : centers[t].z;
+		(c < middle ? left : right).triangles.push_back(piece.triangles[t]);
+	}
+
+	return !left.triangles.empty() && !right.triangles.empty();
+}
+
+
+// A piece cut in two, and the hull volume the cut saves.
+struct HullSplit
+{
+	bool valid;
+	double gain;
+	HullPiece left, right;
+};
+
+
+static void EvaluateSplit(const Mesh& mesh, const HullPiece& piece, const CollisionOptions& options, HullSplit& split)
+{
+	split.valid = false;
+	split.left.triangles.clear();
+	split.right.triangles.clear();
+	if (piece.hull.volume <= 0.0 || !SplitPiece(mesh, piece, split.left, split.right))
+	{
+		return;
+	}
+
+	PieceHull(mesh, split.left, options.MaxHullVertices);
+	PieceHull(mesh, split.right, options.MaxHullVertices);
+	split.gain = piece.hull.volume - split.left.hull.volume - split.right.hull.volume;
+	split.valid = split.gain >= piece.hull.volume * options.MinSplitGain;
+}
+
+
+// The hulls of one subset. With more than one hull allowed, the piece whose
+// split saves the most hull volume is split until the budget is used or no
+// split saves at least MinSplitGain of its piece's volume.
+static void SubsetHulls(const Mesh& mesh, const ULONG* begin, const ULONG* end, const CollisionOptions& options, vector<HullPiece>& pieces)
+{
+	pieces.assign(1, HullPiece());
+	pieces[0].triangles.assign(begin, end);
+	PieceHull(mesh, pieces[0], options.MaxHullVertices);
+	if (options.MaxHulls <= 1)
+	{
+		return;
+	}
+
+	vector<HullSplit> splits(1);
+	EvaluateSplit(mesh, pieces[0], options, splits[0]);
+	while (pieces.size() < options.MaxHulls)
+	{
+		size_t best = pieces.size();
+		for (size_t i = 0; i < splits.size(); i++)
+		{
+			if (splits[i].valid && (best == pieces.size() || splits[i].gain > splits[best].gain))
+			{
+				best = i;
+			}
+		}
+		if (best == pieces.size())
+		{
+			break;
+		}
+
+		pieces[best] = splits[best].left;
+		pieces.push_back(splits[best].right);
+		splits.resize(pieces.size());
+		EvaluateSplit(mesh, pieces[best], options, splits[best]);
+		EvaluateSplit(mesh, pieces.back(), options, splits.back());
+	}
+}
+
+
+bool BuildCollisionHulls(Mesh& mesh, const CollisionOptions& options, const CoordinateSystem& system, Arena& arena)
+{
+	if (options.MaxHullVertices < 4 || options.MaxHulls < 1)
+	{
+		return false;
+	}
+
+	UINT objects = mesh.ObjectCount;
+	SubsetTriangles groups;
+	if (!GroupTrianglesBySubset(mesh, arena, groups))
+	{
+		return false;
+	}
+
+	// Subsets are independent, so they are hulled side by side.
+	vector<vector<HullPiece> > subsetPieces(objects);
+	ParallelFor(objects, 1, [&](size_t begin, size_t end) {
+		for (size_t s = begin; s < end; s++)
+		{
+			if (groups.Start[s + 1] > groups.Start[s])
+			{
+				SubsetHulls(mesh, groups.Order + groups.Start[s], groups.Order + groups.Start[s + 1], options, subsetPieces[s]);
+			}
+		}
+	});
+
+	UINT hullCount = 0, vertexCount = 0, indexCount = 0;
+	for (UINT s = 0; s < objects; s++)
+	{
+		for (size_t i = 0; i < subsetPieces[s].size(); i++)
+		{
+			hullCount++;
+			vertexCount += (UINT)subsetPieces[s][i].hull.points.size();
+			indexCount += (UINT)subsetPieces[s][i].hull.triangles.size();
+		}
+	}
+
+	HullDesc* hulls = arena.NewArray<HullDesc>(hullCount);
+	XMFLOAT3* vertices = arena.NewArray<XMFLOAT3>(vertexCount);
+	UINT* indices = arena.NewArray<UINT>(indexCount);
+	if (!hulls || !vertices || !indices)
+	{
+		return false;
+	}
+
+	// Triangles face out the way the render mesh's front faces do.
+	bool outward = (system.Handedness == HANDED_LEFT) == (system.Winding == WINDING_CW);
+
+	UINT hull = 0, vertex = 0, index = 0;
+	for (UINT s = 0; s < objects; s++)
+	{
+		for (size_t i = 0; i < subsetPieces[s].size(); i++)
+		{
+			const HullResult& result = subsetPieces[s][i].hull;
+
+			HullDesc& desc = hulls[hull++];
+			desc.SubsetID = s;
+			desc.VertexStart = vertex;
+			desc.VertexCount = (UINT)result.points.size();
+			desc.IndexStart = index;
+			desc.IndexCount = (UINT)result.triangles.size();
+
+			for (size_t k = 0; k < result.points.size(); k++)
+			{
+				vertices[vertex++] = XMFLOAT3((float)result.points[k].x, (float)result.points[k].y, (float)result.points[k].z);
+			}
+			for (size_t k = 0; k < result.triangles.size(); k += 3)
+			{
+				indices[index++] = result.triangles[k];
+				indices[index++] = result.triangles[k + (outward ? 1 : 2)];
+				indices[index++] = result.triangles[k + (outward ? 2 : 1)];
+			}
+		}
+	}
+
+	mesh.Hulls = hulls;
+	mesh.HullCount = hullCount;
+	mesh.HullVertices = vertices;
+	mesh.HullVertexCount = vertexCount;
+	mesh.HullIndices = indices;
+	mesh.HullIndexCount = indexCount;
+
+	return true;
+}
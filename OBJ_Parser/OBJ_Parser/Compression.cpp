@@ -0,0 +1,940 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Compression.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <cstring>
+#include "ModelParser.h"
+using namespace std;
+
+
+// A vertex is handled as nine 32 bit words: pos, tex, Normal and ID.
+static const size_t VERTEX_WORDS = sizeof(vertexData) / sizeof(std::uint32_t);
+static_assert(sizeof(vertexData) == VERTEX_WORDS * sizeof(std::uint32_t), "vertexData has padding");
+
+// Sections are packed in chunks that are transposed and compressed on their
+// own. Each chunk is a 32 bit packed size followed by its LZ block or entropy
+// coded planes, and its deltas restart at zero, so a chunk decodes in cache
+// with a chunk of scratch.
+static const ULONG VERTEX_CHUNK = 4096;
+static const ULONG INDEX_CHUNK = 32768;
+
+// LZ block format: a token byte holds the literal length in the high nibble and
+// the match length minus LZ_MIN_MATCH in the low nibble. A nibble of 15 is
+// continued with bytes that add 255 until one is smaller. Literals follow the
+// token, then a two byte little endian offset. The last sequence has no match.
+static const size_t LZ_MIN_MATCH = 4;
+static const size_t LZ_MAX_OFFSET = 65535;
+static const int LZ_HASH_BITS = 16;
+
+
+static std::uint32_t Read32(const unsigned char* p)
+{
+	std::uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+
+// Largest packed section for rawBytes split into chunks.
+static size_t PackedBound(size_t rawBytes, size_t chunks)
+{
+	return rawBytes + rawBytes / 255 + chunks * (sizeof(std::uint32_t) + 16);
+}
+
+
+static unsigned char* LZWriteLength(unsigned char* op, size_t length)
+{
+	while (length >= 255)
+	{
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = (unsigned char)length;
+	return op;
+}
+
+
+// The table holds 1 << LZ_HASH_BITS positions and is cleared here.
+static size_t LZCompress(const unsigned char* src, size_t size, unsigned char* dst, std::uint32_t* table)
+{
+	memset(table, 0, sizeof(std::uint32_t) << LZ_HASH_BITS);
+
+	const unsigned char* ip = src;
+	const unsigned char* anchor = src;
+	const unsigned char* end = src + size;
+	unsigned char* op = dst;
+
+	// Runs of misses skip ahead faster, which keeps incompressible planes cheap.
+	size_t misses = 0;
+	while (size >= LZ_MIN_MATCH && ip + LZ_MIN_MATCH <= end)
+	{
+		std::uint32_t sequence = Read32(ip);
+		std::uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+		const unsigned char* ref = src + table[hash];
+		table[hash] = (std::uint32_t)(ip - src);
+
+		if (ref >= ip || ip - ref > (ptrdiff_t)LZ_MAX_OFFSET || Read32(ref) != sequence)
+		{
+			ip += 1 + (misses++ >> 6);
+			continue;
+		}
+		misses = 0;
+
+		const unsigned char* match = ip + LZ_MIN_MATCH;
+		ref += LZ_MIN_MATCH;
+		while (match + 8 <= end)
+		{
+			std::uint64_t a, b;
+			memcpy(&a, match, sizeof(a));
+			memcpy(&b, ref, sizeof(b));
+			if (a != b)
+			{
+				break;
+			}
+			match += 8;
+			ref += 8;
+		}
+		while (match < end && *match == *ref)
+		{
+			match++;
+			ref++;
+		}
+
+		size_t literals = ip - anchor;
+		size_t length = match - ip - LZ_MIN_MATCH;
+		size_t offset = match - ref;
+
+		unsigned char* token = op++;
+		*token = (unsigned char)(((literals < 15 ? literals : 15) << 4) | (length < 15 ? length : 15));
+		if (literals >= 15)
+		{
+			op = LZWriteLength(op, literals - 15);
+		}
+		memcpy(op, anchor, literals);
+		op += literals;
+		*op++ = (unsigned char)offset;
+		*op++ = (unsigned char)(offset >> 8);
+		if (length >= 15)
+		{
+			op = LZWriteLength(op, length - 15);
+		}
+
+		ip = anchor = match;
+	}
+
+	size_t literals = end - anchor;
+	*op++ = (unsigned char)((literals < 15 ? literals : 15) << 4);
+	if (literals >= 15)
+	{
+		op = LZWriteLength(op, literals - 15);
+	}
+	memcpy(op, anchor, literals);
+	op += literals;
+
+	return op - dst;
+}
+
+
+static bool LZReadLength(const unsigned char*& ip, const unsigned char* end, size_t& length)
+{
+	unsigned char byte;
+	do
+	{
+		if (ip >= end)
+		{
+			return false;
+		}
+		byte = *ip++;
+		length += byte;
+	} while (byte == 255);
+
+	return true;
+}
+
+
+// Every length and offset is checked, so a corrupt file fails instead of
+// writing outside dst.
+static bool LZDecompress(const unsigned char* src, size_t size, unsigned char* dst, size_t dstSize)
+{
+	const unsigned char* ip = src;
+	const unsigned char* end = src + size;
+	unsigned char* op = dst;
+	unsigned char* dstEnd = dst + dstSize;
+
+	while (ip < end)
+	{
+		unsigned char token = *ip++;
+
+		size_t literals = token >> 4;
+		if (literals == 15 && !LZReadLength(ip, end, literals))
+		{
+			return false;
+		}
+		if (literals > (size_t)(end - ip) || literals > (size_t)(dstEnd - op))
+		{
+			return false;
+		}
+		if (literals <= 16 && end - ip >= 16 && dstEnd - op >= 16)
+		{
+			// Short runs are copied as one fixed block; the overshoot is rewritten.
+			memcpy(op, ip, 16);
+		}
+		else
+		{
+			memcpy(op, ip, literals);
+		}
+		ip += literals;
+		op += literals;
+
+		if (ip == end)
+		{
+			break;
+		}
+
+		if (end - ip < 2)
+		{
+			return false;
+		}
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		size_t length = token & 15;
+		if (length == 15 && !LZReadLength(ip, end, length))
+		{
+			return false;
+		}
+		length += LZ_MIN_MATCH;
+
+		if (offset == 0 || offset > (size_t)(op - dst) || length > (size_t)(dstEnd - op))
+		{
+			return false;
+		}
+
+		const unsigned char* ref = op - offset;
+		if (offset >= 16 && length + 16 <= (size_t)(dstEnd - op))
+		{
+			// Copies whole 16 byte chunks; the overshoot is rewritten by later output.
+			unsigned char* copyEnd = op + length;
+			while (op < copyEnd)
+			{
+				memcpy(op, ref, 16);
+				op += 16;
+				ref += 16;
+			}
+			op = copyEnd;
+		}
+		else if (offset >= 8 && length + 16 <= (size_t)(dstEnd - op))
+		{
+			// Copies whole 8 byte chunks; the overshoot is rewritten by later output.
+			unsigned char* copyEnd = op + length;
+			while (op < copyEnd)
+			{
+				memcpy(op, ref, 8);
+				op += 8;
+				ref += 8;
+			}
+			op = copyEnd;
+		}
+		else
+		{
+			// A short offset repeats a pattern, so copy the first period and
+			// then keep doubling what has already been written.
+			size_t copied = offset < length ? offset : length;
+			memcpy(op, ref, copied);
+			while (copied < length)
+			{
+				size_t count = copied < length - copied ? copied : length - copied;
+				memcpy(op + copied, op, count);
+				copied += count;
+			}
+			op += length;
+		}
+	}
+
+	return op == dstEnd;
+}
+
+
+// Entropy chunks code every byte plane on its own, which suits the skewed
+// sign, exponent and high mantissa bytes of float deltas better than LZ. The
+// top bit of a chunk's size marks one; the other chunks are LZ blocks. Each
+// plane is a mode byte followed by:
+//   PLANE_STORED    the plane's bytes
+//   PLANE_CONSTANT  the one byte the whole plane holds
+//   PLANE_HUFFMAN   the highest symbol used, the code length of every symbol
+//                   up to it in nibbles, a 32 bit byte count and the codes,
+//                   read from the low bit of each byte up
+static const std::uint32_t CHUNK_ENTROPY = 0x80000000u;
+static const unsigned char PLANE_STORED = 0;
+static const unsigned char PLANE_CONSTANT = 1;
+static const unsigned char PLANE_HUFFMAN = 2;
+static const int HUFFMAN_MAX_BITS = 12;
+
+
+// Code lengths for the counts, none longer than HUFFMAN_MAX_BITS. Needs two
+// used symbols or more. Counts of a plane that would make longer codes are
+// halved until they fit, which costs next to nothing in size.
+static void HuffmanLengths(const std::uint32_t* counts, unsigned char* lengths)
+{
+	std::uint32_t weights[256];
+	memcpy(weights, counts, sizeof(weights));
+
+	for (;;)
+	{
+		// Two queues: the leaves sorted by weight, and the inner nodes, which
+		// are made in order of weight anyway.
+		int leaves[256];
+		int leafCount = 0;
+		for (int s = 0; s < 256; s++)
+		{
+			lengths[s] = 0;
+			if (weights[s])
+			{
+				leaves[leafCount++] = s;
+			}
+		}
+		sort(leaves, leaves + leafCount, [&](int a, int b) { return weights[a] < weights[b] || (weights[a] == weights[b] && a < b); });
+
+		std::uint64_t nodeWeight[512];
+		int parent[512];
+		for (int i = 0; i < leafCount; i++)
+		{
+			nodeWeight[i] = weights[leaves[i]];
+		}
+
+		int nextLeaf = 0, nextNode = leafCount, nodes = leafCount;
+		for (int made = 0; made < leafCount - 1; made++)
+		{
+			int pick[2];
+			for (int k = 0; k < 2; k++)
+			{
+				if (nextLeaf < leafCount && (nextNode == nodes || nodeWeight[nextLeaf] <= nodeWeight[nextNode]))
+				{
+					pick[k] = nextLeaf++;
+				}
+				else
+				{
+					pick[k] = nextNode++;
+				}
+			}
+			nodeWeight[nodes] = nodeWeight[pick[0]] + nodeWeight[pick[1]];
+			parent[pick[0]] = parent[pick[1]] = nodes;
+			nodes++;
+		}
+
+		// Depths from the root down; parents are always made after children.
+		int depth[512];
+		depth[nodes - 1] = 0;
+		int longest = 0;
+		for (int i = nodes - 2; i >= 0; i--)
+		{
+			depth[i] = depth[parent[i]] + 1;
+			if (i < leafCount)
+			{
+				lengths[leaves[i]] = (unsigned char)depth[i];
+				longest = depth[i] > longest ? depth[i] : longest;
+			}
+		}
+
+		if (longest <= HUFFMAN_MAX_BITS)
+		{
+			return;
+		}
+		for (int s = 0; s < 256; s++)
+		{
+			weights[s] = weights[s] ? (weights[s] + 1) / 2 : 0;
+		}
+	}
+}
+
+
+// Canonical codes for the lengths, bit reversed so the reader can take them
+// from the low end of its buffer.
+static void HuffmanCodes(const unsigned char* lengths, std::uint32_t* codes)
+{
+	int lengthCount[HUFFMAN_MAX_BITS + 1] = {};
+	for (int s = 0; s < 256; s++)
+	{
+		lengthCount[lengths[s]]++;
+	}
+	lengthCount[0] = 0;
+
+	std::uint32_t next[HUFFMAN_MAX_BITS + 1];
+	std::uint32_t code = 0;
+	for (int l = 1; l <= HUFFMAN_MAX_BITS; l++)
+	{
+		code = (code + lengthCount[l - 1]) << 1;
+		next[l] = code;
+	}
+
+	for (int s = 0; s < 256; s++)
+	{
+		int length = lengths[s];
+		codes[s] = 0;
+		if (!length)
+		{
+			continue;
+		}
+
+		std::uint32_t c = next[length]++;
+		std::uint32_t reversed = 0;
+		for (int b = 0; b < length; b++)
+		{
+			reversed |= ((c >> b) & 1) << (length - 1 - b);
+		}
+		codes[s] = reversed;
+	}
+}
+
+
+// Writes one plane in whichever mode is smallest and returns the bytes used.
+static size_t EntropyPlane(const unsigned char* plane, size_t n, unsigned char* dst)
+{
+	std::uint32_t counts[256] = {};
+	for (size_t i = 0; i < n; i++)
+	{
+		counts[plane[i]]++;
+	}
+
+	int used = 0, highest = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		if (counts[s])
+		{
+			used++;
+			highest = s;
+		}
+	}
+
+	if (used <= 1)
+	{
+		dst[0] = PLANE_CONSTANT;
+		dst[1] = n ? plane[0] : 0;
+		return 2;
+	}
+
+	unsigned char lengths[256];
+	HuffmanLengths(counts, lengths);
+
+	std::uint64_t bits = 0;
+	for (int s = 0; s <= highest; s++)
+	{
+		bits += (std::uint64_t)counts[s] * lengths[s];
+	}
+	size_t tableBytes = (size_t)(highest + 2) / 2;
+	size_t codeBytes = (size_t)((bits + 7) / 8);
+	if (2 + tableBytes + sizeof(std::uint32_t) + codeBytes >= 1 + n)
+	{
+		dst[0] = PLANE_STORED;
+		memcpy(dst + 1, plane, n);
+		return 1 + n;
+	}
+
+	unsigned char* op = dst;
+	*op++ = PLANE_HUFFMAN;
+	*op++ = (unsigned char)highest;
+	for (int s = 0; s <= highest; s += 2)
+	{
+		*op++ = (unsigned char)(lengths[s] | (s + 1 <= highest ? lengths[s + 1] << 4 : 0));
+	}
+	std::uint32_t size = (std::uint32_t)codeBytes;
+	memcpy(op, &size, sizeof(size));
+	op += sizeof(size);
+
+	std::uint32_t codes[256];
+	HuffmanCodes(lengths, codes);
+
+	std::uint64_t buffer = 0;
+	int count = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		buffer |= (std::uint64_t)codes[plane[i]] << count;
+		count += lengths[plane[i]];
+		while (count >= 8)
+		{
+			*op++ = (unsigned char)buffer;
+			buffer >>= 8;
+			count -= 8;
+		}
+	}
+	if (count)
+	{
+		*op++ = (unsigned char)buffer;
+	}
+
+	return op - dst;
+}
+
+
+// Codes planeCount planes of n bytes each and returns the bytes used. dst
+// needs room for planeCount * (n + 1) bytes.
+static size_t EntropyCompress(const unsigned char* planes, size_t planeCount, size_t n, unsigned char* dst)
+{
+	unsigned char* op = dst;
+	for (size_t p = 0; p < planeCount; p++)
+	{
+		op += EntropyPlane(planes + p * n, n, op);
+	}
+	return op - dst;
+}
+
+
+// Decodes the codes of one plane. Like the LZ reader, every length and table
+// entry is checked, so a corrupt file fails instead of writing outside plane.
+static bool HuffmanDecode(const unsigned char* src, size_t size, const unsigned char* lengths, unsigned char* plane, size_t n)
+{
+	// Every code of a complete set fills its share of the table exactly.
+	static const size_t TABLE_SIZE = (size_t)1 << HUFFMAN_MAX_BITS;
+	std::uint16_t table[TABLE_SIZE];
+	std::uint32_t codes[256];
+	HuffmanCodes(lengths, codes);
+
+	size_t filled = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		int length = lengths[s];
+		if (!length)
+		{
+			continue;
+		}
+		filled += TABLE_SIZE >> length;
+		if (filled > TABLE_SIZE)
+		{
+			return false;
+		}
+		for (size_t j = codes[s]; j < TABLE_SIZE; j += (size_t)1 << length)
+		{
+			table[j] = (std::uint16_t)((s << 4) | length);
+		}
+	}
+	if (filled != TABLE_SIZE)
+	{
+		return false;
+	}
+
+	const unsigned char* ip = src;
+	const unsigned char* end = src + size;
+	std::uint64_t buffer = 0;
+	int count = 0;
+	size_t i = 0;
+	while (i < n)
+	{
+		while (count <= 56 && ip < end)
+		{
+			buffer |= (std::uint64_t)*ip++ << count;
+			count += 8;
+		}
+
+		// No code is longer than HUFFMAN_MAX_BITS, so this many symbols are
+		// in the buffer whatever they are.
+		size_t ready = (size_t)count / HUFFMAN_MAX_BITS;
+		if (!ready)
+		{
+			std::uint16_t entry = table[buffer & (TABLE_SIZE - 1)];
+			int length = entry & 15;
+			if (length > count)
+			{
+				return false;
+			}
+			plane[i++] = (unsigned char)(entry >> 4);
+			buffer >>= length;
+			count -= length;
+			continue;
+		}
+
+		if (ready > n - i)
+		{
+			ready = n - i;
+		}
+		for (size_t k = 0; k < ready; k++)
+		{
+			std::uint16_t entry = table[buffer & (TABLE_SIZE - 1)];
+			plane[i++] = (unsigned char)(entry >> 4);
+			buffer >>= entry & 15;
+			count -= entry & 15;
+		}
+	}
+
+	// What is left is the padding of the last byte.
+	return ip == end && count < 8;
+}
+
+
+static bool EntropyDecompress(const unsigned char* src, size_t size, unsigned char* planes, size_t planeCount, size_t n)
+{
+	const unsigned char* ip = src;
+	const unsigned char* end = src + size;
+	for (size_t p = 0; p < planeCount; p++)
+	{
+		unsigned char* plane = planes + p * n;
+		if (ip >= end)
+		{
+			return false;
+		}
+
+		unsigned char mode = *ip++;
+		if (mode == PLANE_STORED)
+		{
+			if ((size_t)(end - ip) < n)
+			{
+				return false;
+			}
+			memcpy(plane, ip, n);
+			ip += n;
+		}
+		else if (mode == PLANE_CONSTANT)
+		{
+			if (ip >= end)
+			{
+				return false;
+			}
+			memset(plane, *ip++, n);
+		}
+		else if (mode == PLANE_HUFFMAN)
+		{
+			if (ip >= end)
+			{
+				return false;
+			}
+			int highest = *ip++;
+			size_t tableBytes = (size_t)(highest + 2) / 2;
+			if ((size_t)(end - ip) < tableBytes + sizeof(std::uint32_t))
+			{
+				return false;
+			}
+
+			unsigned char lengths[256] = {};
+			for (int s = 0; s <= highest; s++)
+			{
+				lengths[s] = (ip[s / 2] >> ((s & 1) * 4)) & 15;
+				if (lengths[s] > HUFFMAN_MAX_BITS)
+				{
+					return false;
+				}
+			}
+			ip += tableBytes;
+
+			std::uint32_t codeBytes;
+			memcpy(&codeBytes, ip, sizeof(codeBytes));
+			ip += sizeof(codeBytes);
+			if (codeBytes > (size_t)(end - ip) || !HuffmanDecode(ip, codeBytes, lengths, plane, n))
+			{
+				return false;
+			}
+			ip += codeBytes;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return ip == end;
+}
+
+
+// Writes planeCount planes of n bytes at op as an LZ block or entropy chunk,
+// whichever is smaller, and returns the bytes used. scratch holds the entropy
+// chunk while the two are compared and needs planeCount * (n + 1) bytes.
+static size_t WriteChunk(const unsigned char* planes, size_t planeCount, size_t n, unsigned char* op, unsigned char* scratch, std::uint32_t* table)
+{
+	size_t bytes = LZCompress(planes, planeCount * n, op + sizeof(std::uint32_t), table);
+	size_t entropy = EntropyCompress(planes, planeCount, n, scratch);
+
+	std::uint32_t value = (std::uint32_t)bytes;
+	if (entropy < bytes)
+	{
+		memcpy(op + sizeof(std::uint32_t), scratch, entropy);
+		bytes = entropy;
+		value = (std::uint32_t)entropy | CHUNK_ENTROPY;
+	}
+	memcpy(op, &value, sizeof(value));
+
+	return sizeof(std::uint32_t) + bytes;
+}
+
+
+// Decodes the next chunk of the section into planeCount planes of n bytes.
+// Fails if the chunk does not fit in the section or does not decode to them.
+static bool ReadChunk(const unsigned char*& ip, const unsigned char* end, unsigned char* planes, size_t planeCount, size_t n)
+{
+	std::uint32_t value;
+	if (end - ip < (ptrdiff_t)sizeof(value))
+	{
+		return false;
+	}
+	memcpy(&value, ip, sizeof(value));
+	ip += sizeof(value);
+
+	size_t size = value & ~CHUNK_ENTROPY;
+	if (size > (size_t)(end - ip))
+	{
+		return false;
+	}
+
+	const unsigned char* block = ip;
+	ip += size;
+	if (value & CHUNK_ENTROPY)
+	{
+		return EntropyDecompress(block, size, planes, planeCount, n);
+	}
+	return LZDecompress(block, size, planes, planeCount * n);
+}
+
+
+// Whether the chunk at ip lies wholly before end, so it can be decoded.
+static bool ChunkArrived(const unsigned char* ip, const unsigned char* end)
+{
+	if (end - ip < (ptrdiff_t)sizeof(std::uint32_t))
+	{
+		return false;
+	}
+
+	return (Read32(ip) & ~CHUNK_ENTROPY) <= (size_t)(end - ip) - sizeof(std::uint32_t);
+}
+
+
+bool PackVertices(const vertexData* vertices, ULONG count, Arena& arena, const unsigned char*& packed, size_t& size)
+{
+	// Each word is replaced by its difference to the same word of the previous
+	// vertex, then the bytes are split into planes so the slowly changing sign
+	// and exponent bytes of neighbouring vertices sit next to each other.
+	size_t chunks = (count + VERTEX_CHUNK - 1) / VERTEX_CHUNK;
+	unsigned char* planes = arena.NewArray<unsigned char>((size_t)VERTEX_CHUNK * sizeof(vertexData));
+	unsigned char* scratch = arena.NewArray<unsigned char>((size_t)(VERTEX_CHUNK + 1) * sizeof(vertexData));
+	unsigned char* out = arena.NewArray<unsigned char>(PackedBound((size_t)count * sizeof(vertexData), chunks));
+	std::uint32_t* table = arena.NewArray<std::uint32_t>(1 << LZ_HASH_BITS);
+	if (!planes || !scratch || !out || !table)
+	{
+		return false;
+	}
+
+	const std::uint32_t* words = (const std::uint32_t*)vertices;
+	unsigned char* op = out;
+	for (ULONG first = 0; first < count; first += VERTEX_CHUNK)
+	{
+		ULONG n = count - first < VERTEX_CHUNK ? count - first : VERTEX_CHUNK;
+		for (size_t w = 0; w < VERTEX_WORDS; w++)
+		{
+			const std::uint32_t* in = words + (size_t)first * VERTEX_WORDS + w;
+			unsigned char* plane0 = planes + (w * 4 + 0) * n;
+			unsigned char* plane1 = planes + (w * 4 + 1) * n;
+			unsigned char* plane2 = planes + (w * 4 + 2) * n;
+			unsigned char* plane3 = planes + (w * 4 + 3) * n;
+			std::uint32_t previous = 0;
+			for (ULONG i = 0; i < n; i++)
+			{
+				std::uint32_t word = in[i * VERTEX_WORDS];
+				std::uint32_t delta = word - previous;
+				previous = word;
+
+				plane0[i] = (unsigned char)delta;
+				plane1[i] = (unsigned char)(delta >> 8);
+				plane2[i] = (unsigned char)(delta >> 16);
+				plane3[i] = (unsigned char)(delta >> 24);
+			}
+		}
+
+		op += WriteChunk(planes, sizeof(vertexData), n, op, scratch, table);
+	}
+
+	packed = out;
+	size = op - out;
+
+	return true;
+}
+
+
+bool UnpackVertices(const unsigned char* packed, size_t size, vertexData* vertices, ULONG count, Arena& arena)
+{
+	SectionUnpacker unpacker;
+	if (!BeginUnpackVertices(unpacker, packed, arena))
+	{
+		return false;
+	}
+
+	while (unpacker.Done < count)
+	{
+		ULONG done = unpacker.Done;
+		if (!UnpackVertexChunk(unpacker, packed + size, vertices, count) || unpacker.Done == done)
+		{
+			return false;
+		}
+	}
+
+	return unpacker.Next == packed + size;
+}
+
+
+bool BeginUnpackVertices(SectionUnpacker& unpacker, const unsigned char* packed, Arena& arena)
+{
+	unpacker.Next = packed;
+	unpacker.Done = 0;
+	unpacker.Planes = arena.NewArray<unsigned char>((size_t)VERTEX_CHUNK * sizeof(vertexData));
+	unpacker.Delta = arena.NewArray<std::uint32_t>((size_t)VERTEX_CHUNK * VERTEX_WORDS);
+
+	return unpacker.Planes && unpacker.Delta;
+}
+
+
+bool UnpackVertexChunk(SectionUnpacker& unpacker, const unsigned char* end, vertexData* vertices, ULONG count)
+{
+	if (unpacker.Done >= count || !ChunkArrived(unpacker.Next, end))
+	{
+		return true;
+	}
+
+	unsigned char* planes = unpacker.Planes;
+	std::uint32_t* delta = unpacker.Delta;
+	std::uint32_t* words = (std::uint32_t*)vertices;
+
+	ULONG first = unpacker.Done;
+	ULONG n = count - first < VERTEX_CHUNK ? count - first : VERTEX_CHUNK;
+	if (!ReadChunk(unpacker.Next, end, planes, sizeof(vertexData), n))
+	{
+		return false;
+	}
+
+	// The bytes of each word are joined for the whole chunk first, which
+	// vectorizes. The running sums then go vertex by vertex, so the nine
+	// chains overlap and the output is written in order.
+	for (size_t w = 0; w < VERTEX_WORDS; w++)
+	{
+		const unsigned char* plane0 = planes + (w * 4 + 0) * n;
+		const unsigned char* plane1 = planes + (w * 4 + 1) * n;
+		const unsigned char* plane2 = planes + (w * 4 + 2) * n;
+		const unsigned char* plane3 = planes + (w * 4 + 3) * n;
+		std::uint32_t* column = delta + w * VERTEX_CHUNK;
+		for (ULONG i = 0; i < n; i++)
+		{
+			column[i] = (std::uint32_t)plane0[i] | ((std::uint32_t)plane1[i] << 8) | ((std::uint32_t)plane2[i] << 16) | ((std::uint32_t)plane3[i] << 24);
+		}
+	}
+
+	std::uint32_t* out = words + (size_t)first * VERTEX_WORDS;
+	std::uint32_t previous[VERTEX_WORDS] = {};
+	for (ULONG i = 0; i < n; i++)
+	{
+		for (size_t w = 0; w < VERTEX_WORDS; w++)
+		{
+			previous[w] += delta[w * VERTEX_CHUNK + i];
+			out[i * VERTEX_WORDS + w] = previous[w];
+		}
+	}
+	unpacker.Done += n;
+
+	return true;
+}
+
+
+bool PackIndices(const ULONG* indices, ULONG count, Arena& arena, const unsigned char*& packed, size_t& size)
+{
+	// Neighbouring indices are close, so the zigzag coded differences are small
+	// and their upper byte planes are almost all zero.
+	size_t chunks = (count + INDEX_CHUNK - 1) / INDEX_CHUNK;
+	unsigned char* planes = arena.NewArray<unsigned char>((size_t)INDEX_CHUNK * sizeof(ULONG));
+	unsigned char* scratch = arena.NewArray<unsigned char>((size_t)(INDEX_CHUNK + 1) * sizeof(ULONG));
+	unsigned char* out = arena.NewArray<unsigned char>(PackedBound((size_t)count * sizeof(ULONG), chunks));
+	std::uint32_t* table = arena.NewArray<std::uint32_t>(1 << LZ_HASH_BITS);
+	if (!planes || !scratch || !out || !table)
+	{
+		return false;
+	}
+
+	unsigned char* op = out;
+	for (ULONG first = 0; first < count; first += INDEX_CHUNK)
+	{
+		ULONG n = count - first < INDEX_CHUNK ? count - first : INDEX_CHUNK;
+		const ULONG* in = indices + first;
+		ULONG previous = 0;
+		for (ULONG i = 0; i < n; i++)
+		{
+			std::int32_t delta = (std::int32_t)(in[i] - previous);
+			std::uint32_t zigzag = ((std::uint32_t)delta << 1) ^ (std::uint32_t)(delta >> 31);
+			previous = in[i];
+
+			planes[i] = (unsigned char)zigzag;
+			planes[n + i] = (unsigned char)(zigzag >> 8);
+			planes[n * 2 + i] = (unsigned char)(zigzag >> 16);
+			planes[n * 3 + i] = (unsigned char)(zigzag >> 24);
+		}
+
+		op += WriteChunk(planes, sizeof(ULONG), n, op, scratch, table);
+	}
+
+	packed = out;
+	size = op - out;
+
+	return true;
+}
+
+
+bool UnpackIndices(const unsigned char* packed, size_t size, ULONG* indices, ULONG count, Arena& arena)
+{
+	SectionUnpacker unpacker;
+	if (!BeginUnpackIndices(unpacker, packed, arena))
+	{
+		return false;
+	}
+
+	while (unpacker.Done < count)
+	{
+		ULONG done = unpacker.Done;
+		if (!UnpackIndexChunk(unpacker, packed + size, indices, count) || unpacker.Done == done)
+		{
+			return false;
+		}
+	}
+
+	return unpacker.Next == packed + size;
+}
+
+
+bool BeginUnpackIndices(SectionUnpacker& unpacker, const unsigned char* packed, Arena& arena)
+{
+	unpacker.Next = packed;
+	unpacker.Done = 0;
+	unpacker.Planes = arena.NewArray<unsigned char>((size_t)INDEX_CHUNK * sizeof(ULONG));
+	unpacker.Delta = 0;
+
+	return unpacker.Planes != 0;
+}
+
+
+bool UnpackIndexChunk(SectionUnpacker& unpacker, const unsigned char* end, ULONG* indices, ULONG count)
+{
+	if (unpacker.Done >= count || !ChunkArrived(unpacker.Next, end))
+	{
+		return true;
+	}
+
+	unsigned char* planes = unpacker.Planes;
+
+	ULONG first = unpacker.Done;
+	ULONG n = count - first < INDEX_CHUNK ? count - first : INDEX_CHUNK;
+	if (!ReadChunk(unpacker.Next, end, planes, sizeof(ULONG), n))
+	{
+		return false;
+	}
+
+	// The differences are decoded in place first, which vectorizes, and then
+	// summed up.
+	ULONG* out = indices + first;
+	for (ULONG i = 0; i < n; i++)
+	{
+		std::uint32_t zigzag = (std::uint32_t)planes[i] | ((std::uint32_t)planes[n + i] << 8) | ((std::uint32_t)planes[n * 2 + i] << 16) | ((std::uint32_t)planes[n * 3 + i] << 24);
+		out[i] = (zigzag >> 1) ^ (0u - (zigzag & 1));
+	}
+	for (ULONG i = 1; i < n; i++)
+	{
+		out[i] += out[i - 1];
+	}
+	unpacker.Done += n;
+
+	return true;
+}
@@ -0,0 +1,198 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Coordinates.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include "ModelParser.h"
+#include "Simd.h"
+using namespace std;
+
+
+void DefaultCoordinateSystem(CoordinateSystem& system)
+{
+	// What the converter has always written: Direct3D's left handed, y up
+	// space with clockwise front faces and texture rows from the top.
+	system.Handedness = HANDED_LEFT;
+	system.UpAxis = UP_AXIS_Y;
+	system.Winding = WINDING_CW;
+	system.UVOrigin = UV_ORIGIN_TOP_LEFT;
+	system.UnitScale = 1.0f;
+}
+
+
+void ObjCoordinateSystem(CoordinateSystem& system)
+{
+	system.Handedness = HANDED_RIGHT;
+	system.UpAxis = UP_AXIS_Y;
+	system.Winding = WINDING_CCW;
+	system.UVOrigin = UV_ORIGIN_BOTTOM_LEFT;
+	system.UnitScale = 1.0f;
+}
+
+
+void M3DCoordinateSystem(CoordinateSystem& system)
+{
+	// The triangles of .m3d files have always been turned around on the way
+	// to the default output, so their winding counts as counter clockwise.
+	system.Handedness = HANDED_LEFT;
+	system.UpAxis = UP_AXIS_Y;
+	system.Winding = WINDING_CCW;
+	system.UVOrigin = UV_ORIGIN_TOP_LEFT;
+	system.UnitScale = 1.0f;
+}
+
+
+// The axis change as a signed permutation: output component k is
+// sign[k] * input[axis[k]]. Turning z up into y up, mirroring and turning y up
+// into z up only ever exchange y and z.
+static void AxisMapping(const CoordinateSystem& from, const CoordinateSystem& to, UINT axis[3], float sign[3])
+{
+	for (UINT k = 0; k < 3; k++)
+	{
+		axis[k] = k;
+		sign[k] = 1.0f;
+	}
+
+	// z up to y up turns (x, y, z) into (x, z, -y).
+	if (from.UpAxis == UP_AXIS_Z)
+	{
+		UINT a = axis[1];
+		float s = sign[1];
+		axis[1] = axis[2];
+		sign[1] = sign[2];
+		axis[2] = a;
+		sign[2] = -s;
+	}
+
+	// Changing hands mirrors the forward axis.
+	if (from.Handedness != to.Handedness)
+	{
+		sign[2] = -sign[2];
+	}
+
+	// y up to z up turns (x, y, z) into (x, -z, y).
+	if (to.UpAxis == UP_AXIS_Z)
+	{
+		UINT a = axis[1];
+		float s = sign[1];
+		axis[1] = axis[2];
+		sign[1] = -sign[2];
+		axis[2] = a;
+		sign[2] = s;
+	}
+}
+
+
+#ifdef MODEL_SSE2
+
+// Moves the positions and normals four lanes at a time. A position load also
+// picks up tex.x and a normal load the ID; the sign mask leaves both alone and
+// the scaled lanes are blended back so tex.x keeps its exact bits.
+template <bool SwapYZ>
+static void TransformVertices(vertexData* vertices, UINT count, const float sign[3], float scale)
+{
+	const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	const __m128 signs = _mm_castsi128_ps(_mm_set_epi32(0,
+		sign[2] < 0.0f ? (int)0x80000000 : 0,
+		sign[1] < 0.0f ? (int)0x80000000 : 0,
+		sign[0] < 0.0f ? (int)0x80000000 : 0));
+	const __m128 scales = _mm_set1_ps(scale);
+
+	for (UINT i = 0; i < count; i++)
+	{
+		float* position = &vertices[i].pos.x;
+		float* normal = &vertices[i].Normal.x;
+
+		__m128 p = _mm_loadu_ps(position);
+		__m128 n = _mm_loadu_ps(normal);
+		if (SwapYZ)
+		{
+			p = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 1, 2, 0));
+			n = _mm_shuffle_ps(n, n, _MM_SHUFFLE(3, 1, 2, 0));
+		}
+		p = _mm_xor_ps(p, signs);
+		n = _mm_xor_ps(n, signs);
+		p = _mm_or_ps(_mm_and_ps(xyz, _mm_mul_ps(p, scales)), _mm_andnot_ps(xyz, p));
+
+		_mm_storeu_ps(position, p);
+		_mm_storeu_ps(normal, n);
+	}
+}
+
+#else
+
+template <bool SwapYZ>
+static void TransformVertices(vertexData* vertices, UINT count, const float sign[3], float scale)
+{
+	for (UINT i = 0; i < count; i++)
+	{
+		DirectX::XMFLOAT3& p = vertices[i].pos;
+		DirectX::XMFLOAT3& n = vertices[i].Normal;
+
+		if (SwapYZ)
+		{
+			float t = p.y;
+			p.y = p.z;
+			p.z = t;
+			t = n.y;
+			n.y = n.z;
+			n.z = t;
+		}
+
+		p.x = p.x * sign[0] * scale;
+		p.y = p.y * sign[1] * scale;
+		p.z = p.z * sign[2] * scale;
+		n.x = n.x * sign[0];
+		n.y = n.y * sign[1];
+		n.z = n.z * sign[2];
+	}
+}
+
+#endif
+
+
+void ConvertCoordinates(Mesh& mesh, const CoordinateSystem& from, const CoordinateSystem& to)
+{
+	UINT axis[3];
+	float sign[3];
+	AxisMapping(from, to, axis, sign);
+	float scale = from.UnitScale / to.UnitScale;
+
+	bool identity = axis[1] == 1 && sign[0] > 0.0f && sign[1] > 0.0f && sign[2] > 0.0f && scale == 1.0f;
+	if (!identity)
+	{
+		if (axis[1] == 1)
+		{
+			TransformVertices<false>(mesh.Vertices, mesh.VertexCount, sign, scale);
+		}
+		else
+		{
+			TransformVertices<true>(mesh.Vertices, mesh.VertexCount, sign, scale);
+		}
+	}
+
+	if (from.UVOrigin != to.UVOrigin)
+	{
+		vertexData* vertices = mesh.Vertices;
+		for (UINT i = 0; i < mesh.VertexCount; i++)
+		{
+			vertices[i].tex.y = 1.0f - vertices[i].tex.y;
+		}
+	}
+
+	// The winding is told apart in each system's own hands, so mirroring
+	// alone keeps it and only a change of convention turns the triangles.
+	if (from.Winding != to.Winding)
+	{
+		ULONG* indices = mesh.Indices;
+		for (UINT i = 0; i + 2 < mesh.IndexCount; i += 3)
+		{
+			ULONG b = indices[i + 1];
+			indices[i + 1] = indices[i + 2];
+			indices[i + 2] = b;
+		}
+	}
+}
@@ -0,0 +1,256 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Inspector.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstdlib>
+#include <cstring>
+#include "ModelParser.h"
+#include "TextWriter.h"
+using namespace std;
+
+
+void DefaultInspectOptions(InspectOptions& options)
+{
+	options.Subsets.clear();
+	options.DumpVertices = false;
+	options.VertexBegin = 0;
+	options.VertexEnd = ~0u;
+	options.DumpIndices = false;
+	options.IndexBegin = 0;
+	options.IndexEnd = ~0u;
+}
+
+
+bool ParseRange(const char* text, ULONG& begin, ULONG& end)
+{
+	// Accepts A:B, A:, :B and a single A.
+	const char* colon = strchr(text, ':');
+	char* stop;
+
+	begin = 0;
+	end = ~0u;
+
+	if (colon != text)
+	{
+		begin = (ULONG)strtoul(text, &stop, 10);
+		if (stop == text || (*stop != ':' && *stop != '\0'))
+		{
+			return false;
+		}
+	}
+
+	if (!colon)
+	{
+		end = begin + 1;
+		return true;
+	}
+
+	if (colon[1] != '\0')
+	{
+		end = (ULONG)strtoul(colon + 1, &stop, 10);
+		if (stop == colon + 1 || *stop != '\0')
+		{
+			return false;
+		}
+	}
+
+	return begin <= end;
+}
+
+
+bool InspectSMF(const SMFView& view, const InspectOptions& options, Arena& arena, TextWriter& out)
+{
+	const Header& head = *view.Head;
+
+	// Subsets selected for the summary and the dumps. No selection means all.
+	bool* selected = arena.NewArray<bool>(head.ObjectCount + 1);
+	ULONG* vertexCount = arena.NewArray<ULONG>(head.ObjectCount + 1);
+	ULONG* firstVertex = arena.NewArray<ULONG>(head.ObjectCount + 1);
+	ULONG* lastVertex = arena.NewArray<ULONG>(head.ObjectCount + 1);
+	ULONG* triangleCount = arena.NewArray<ULONG>(head.ObjectCount + 1);
+	if (!selected || !vertexCount || !firstVertex || !lastVertex || !triangleCount)
+	{
+		return false;
+	}
+
+	for (UINT i = 0; i <= head.ObjectCount; i++)
+	{
+		selected[i] = options.Subsets.empty();
+		vertexCount[i] = 0;
+		firstVertex[i] = 0;
+		lastVertex[i] = 0;
+		triangleCount[i] = 0;
+	}
+	for (size_t i = 0; i < options.Subsets.size(); i++)
+	{
+		if (options.Subsets[i] < head.ObjectCount)
+		{
+			selected[options.Subsets[i]] = true;
+		}
+	}
+
+	// Vertices with an ID outside the subset table are counted in the last slot.
+	DirectX::XMFLOAT3 minimum(0.0f, 0.0f, 0.0f), maximum(0.0f, 0.0f, 0.0f);
+	for (ULONG i = 0; i < head.VertexCount; i++)
+	{
+		const vertexData& v = view.Vertices[i];
+		UINT id = v.ID < head.ObjectCount ? v.ID : head.ObjectCount;
+		if (!vertexCount[id])
+		{
+			firstVertex[id] = i;
+		}
+		lastVertex[id] = i;
+		vertexCount[id]++;
+
+		if (i == 0)
+		{
+			minimum = maximum = v.pos;
+		}
+		minimum.x = v.pos.x < minimum.x ? v.pos.x : minimum.x;
+		minimum.y = v.pos.y < minimum.y ? v.pos.y : minimum.y;
+		minimum.z = v.pos.z < minimum.z ? v.pos.z : minimum.z;
+		maximum.x = v.pos.x > maximum.x ? v.pos.x : maximum.x;
+		maximum.y = v.pos.y > maximum.y ? v.pos.y : maximum.y;
+		maximum.z = v.pos.z > maximum.z ? v.pos.z : maximum.z;
+	}
+	for (ULONG t = 0; t + 2 < head.IndexCount; t += 3)
+	{
+		ULONG v = view.Indices[t];
+		UINT id = v < head.VertexCount && view.Vertices[v].ID < head.ObjectCount ? view.Vertices[v].ID : head.ObjectCount;
+		triangleCount[id]++;
+	}
+
+	out << "VertexCount: " << head.VertexCount << "\n";
+	out << "IndexCount: " << head.IndexCount << "\n";
+	out << "ObjectCount: " << head.ObjectCount << "\n";
+	out << "bfOffBits: " << head.bfOffBits << "\n";
+	for (UINT i = 0; i < view.SectionCount; i++)
+	{
+		const SMFSection& section = view.Sections[i];
+		out << "Section" << i << ": type " << section.Type << ", " << (section.Encoding == SMF_ENCODING_PACKED ? "packed" : "raw");
+		out << ", " << section.Size << " bytes at " << section.Offset << "\n";
+	}
+	if (view.InstanceCount)
+	{
+		out << "Instances: " << view.InstanceCount << "\n";
+	}
+	if (view.Skin)
+	{
+		out << "Skin: blend weights";
+		if (view.Palettes)
+		{
+			out << ", " << view.PaletteBoneCount << " palette entries";
+		}
+		out << "\n";
+	}
+	if (view.HullCount)
+	{
+		out << "Hulls: " << view.HullCount << ", " << view.HullVertexCount << " vertices, " << view.HullIndexCount / 3 << " triangles\n";
+	}
+	out << "Bounds: " << minimum.x << ", " << minimum.y << ", " << minimum.z << " | " << maximum.x << ", " << maximum.y << ", " << maximum.z << "\n\n";
+
+	for (UINT i = 0; i < head.ObjectCount; i++)
+	{
+		if (!selected[i])
+		{
+			continue;
+		}
+
+		const MatrialDesc& m = view.Materials[i];
+		out << "Subset" << i << ": " << vertexCount[i] << " vertices";
+		if (vertexCount[i])
+		{
+			out << " (" << firstVertex[i] << " - " << lastVertex[i] << ")";
+		}
+		out << ", " << triangleCount[i] << " triangles\n";
+		out << "Ambient" << i << ": " << m.Ambient.x << ", " << m.Ambient.y << ", " << m.Ambient.z << "\n";
+		out << "Diffuse" << i << ": " << m.Diffuse.x << ", " << m.Diffuse.y << ", " << m.Diffuse.z << "\n";
+		out << "Specular" << i << ": " << m.Specular.x << ", " << m.Specular.y << ", " << m.Specular.z << "\n";
+		out << "SpecPower" << i << ": " << m.SpecPower << "\n";
+		out << "Reflectivity" << i << ": " << m.Reflectivity.x << ", " << m.Reflectivity.y << ", " << m.Reflectivity.z << "\n";
+		out << "AlphaClip" << i << ": " << m.AlphaClip << "\n";
+		out << "textureSize" << i << ": " << view.TextureSize[i] << "\n";
+		out << "TextureName" << i << ": ";
+		out.Write(view.TextureName[i], strnlen(view.TextureName[i], view.TextureSize[i])) << "\n";
+		if (view.Palettes)
+		{
+			out << "Palette" << i << ": " << view.Palettes[i].Count << " bones\n";
+		}
+	}
+
+	if (options.Subsets.empty() && (vertexCount[head.ObjectCount] || triangleCount[head.ObjectCount]))
+	{
+		out << "Unassigned: " << vertexCount[head.ObjectCount] << " vertices, " << triangleCount[head.ObjectCount] << " triangles\n";
+	}
+
+	// Instances are listed with the object they stand for.
+	for (UINT i = 0; i < view.InstanceCount; i++)
+	{
+		const InstanceDesc& instance = view.Instances[i];
+		if (!selected[instance.ObjectID])
+		{
+			continue;
+		}
+
+		const float (*m)[3] = instance.Transform.m;
+		out << "Instance" << i << ": subset " << instance.SubsetID << " as object " << instance.ObjectID;
+		out << " | " << m[0][0] << ", " << m[0][1] << ", " << m[0][2];
+		out << " | " << m[1][0] << ", " << m[1][1] << ", " << m[1][2];
+		out << " | " << m[2][0] << ", " << m[2][1] << ", " << m[2][2];
+		out << " | " << m[3][0] << ", " << m[3][1] << ", " << m[3][2] << "\n";
+	}
+
+	// Hulls are listed with the subset they enclose.
+	for (UINT i = 0; i < view.HullCount; i++)
+	{
+		const HullDesc& hull = view.Hulls[i];
+		if (!selected[hull.SubsetID])
+		{
+			continue;
+		}
+
+		out << "Hull" << i << ": subset " << hull.SubsetID << ", " << hull.VertexCount << " vertices, " << hull.IndexCount / 3 << " triangles\n";
+	}
+
+	if (options.DumpVertices)
+	{
+		ULONG end = options.VertexEnd < head.VertexCount ? options.VertexEnd : head.VertexCount;
+
+		out << "\n";
+		for (ULONG i = options.VertexBegin; i < end; i++)
+		{
+			const vertexData& v = view.Vertices[i];
+			if (!selected[v.ID < head.ObjectCount ? v.ID : head.ObjectCount])
+			{
+				continue;
+			}
+
+			out << "Point" << i << ": " << v.pos.x << ", " << v.pos.y << ", " << v.pos.z << " | " << v.tex.x << ", " << v.tex.y << " | " << v.Normal.x << ", " << v.Normal.y << ", " << v.Normal.z << " | " << v.ID << "\n";
+		}
+	}
+
+	if (options.DumpIndices)
+	{
+		// The range is in indices and widened to whole triangles.
+		ULONG end = options.IndexEnd < head.IndexCount ? options.IndexEnd : head.IndexCount;
+
+		out << "\nIndex:\n";
+		for (ULONG t = options.IndexBegin / 3 * 3; t + 2 < head.IndexCount && t < end; t += 3)
+		{
+			ULONG v = view.Indices[t];
+			UINT id = v < head.VertexCount && view.Vertices[v].ID < head.ObjectCount ? view.Vertices[v].ID : head.ObjectCount;
+			if (!selected[id])
+			{
+				continue;
+			}
+
+			out << "Triangle" << t / 3 << ": " << view.Indices[t] << ", " << view.Indices[t + 1] << ", " << view.Indices[t + 2] << "\n";
+		}
+	}
+
+	return true;
+}
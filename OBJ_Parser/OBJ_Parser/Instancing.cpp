@@ -0,0 +1,518 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Instancing.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "ModelParser.h"
+using namespace DirectX;
+using namespace std;
+
+
+void DefaultInstanceOptions(InstanceOptions& options)
+{
+	options.PositionTolerance = 1e-4f;
+	options.NormalTolerance = 1e-3f;
+}
+
+
+// A subset's vertices in mesh order and the triangles it owns, with indices
+// local to those vertices.
+struct SubsetGeometry
+{
+	ULONG VertexStart;
+	ULONG VertexCount;
+	ULONG TriangleStart;
+	ULONG TriangleCount;
+	bool Closed;
+	XMFLOAT3 Center;
+	float Radius;
+	unsigned long long Hash;
+};
+
+struct HashedSubset
+{
+	unsigned long long Hash;
+	float Radius;
+	UINT Subset;
+
+	bool operator<(const HashedSubset& other) const
+	{
+		if (Hash != other.Hash)
+		{
+			return Hash < other.Hash;
+		}
+		return Radius < other.Radius || (Radius == other.Radius && Subset < other.Subset);
+	}
+};
+
+
+static XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+
+static float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+
+static XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+
+static XMFLOAT3 Scaled(const XMFLOAT3& a, float s)
+{
+	return XMFLOAT3(a.x * s, a.y * s, a.z * s);
+}
+
+
+static void HashWord(unsigned long long& hash, unsigned long long word)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		hash ^= (word >> (i * 8)) & 0xff;
+		hash *= 1099511628211ull;
+	}
+}
+
+
+// Hashes what a rigid transform keeps exactly: the counts, the triangles in
+// local indices and the texture coordinates. Positions only survive a transform
+// up to rounding, so they are left to the radius sort and MatchSubsets().
+static unsigned long long HashSubset(const Mesh& mesh, const SubsetGeometry& geometry, const ULONG* vertices, const ULONG* triangles)
+{
+	unsigned long long hash = 14695981039346656037ull;
+
+	HashWord(hash, geometry.VertexCount);
+	HashWord(hash, geometry.TriangleCount);
+	for (ULONG i = 0; i < geometry.TriangleCount * 3; i++)
+	{
+		HashWord(hash, triangles[geometry.TriangleStart * 3 + i]);
+	}
+
+	for (ULONG i = 0; i < geometry.VertexCount; i++)
+	{
+		const vertexData& v = mesh.Vertices[vertices[geometry.VertexStart + i]];
+		UINT bits[2];
+		memcpy(bits, &v.tex, sizeof(bits));
+		HashWord(hash, ((unsigned long long)bits[1] << 32) | bits[0]);
+	}
+
+	return hash;
+}
+
+
+// Builds an orthonormal frame from the center and two vertices picked by the
+// source subset, so the same picks give the matching frame on a copy.
+static bool Frame(const XMFLOAT3& center, const XMFLOAT3& a, const XMFLOAT3& b, XMFLOAT3 frame[3])
+{
+	XMFLOAT3 u = Sub(a, center);
+	XMFLOAT3 w = Cross(u, Sub(b, center));
+	float lu = sqrt(Dot(u, u));
+	float lw = sqrt(Dot(w, w));
+	if (lu == 0.0f || lw == 0.0f)
+	{
+		return false;
+	}
+
+	frame[0] = Scaled(u, 1.0f / lu);
+	frame[2] = Scaled(w, 1.0f / lw);
+	frame[1] = Cross(frame[2], frame[0]);
+
+	return true;
+}
+
+
+// Finds the rotation and translation moving the source onto the candidate and
+// checks every vertex against it. Frames are built the same way on both
+// sides, so mirrored copies never match.
+static bool MatchSubsets(const Mesh& mesh, const SubsetGeometry& source, const SubsetGeometry& candidate, const ULONG* vertices, const ULONG* triangles, const InstanceOptions& options, XMFLOAT4X3& transform)
+{
+	if (source.VertexCount != candidate.VertexCount || source.TriangleCount != candidate.TriangleCount)
+	{
+		return false;
+	}
+
+	for (ULONG i = 0; i < source.TriangleCount * 3; i++)
+	{
+		if (triangles[source.TriangleStart * 3 + i] != triangles[candidate.TriangleStart * 3 + i])
+		{
+			return false;
+		}
+	}
+
+	const ULONG* s = vertices + source.VertexStart;
+	const ULONG* c = vertices + candidate.VertexStart;
+
+	// The frame uses the vertex farthest from the center and the one spanning
+	// the largest area with it, which keeps it well conditioned.
+	ULONG farthest = 0, wide = 0;
+	float best = 0.0f;
+	for (ULONG i = 0; i < source.VertexCount; i++)
+	{
+		XMFLOAT3 d = Sub(mesh.Vertices[s[i]].pos, source.Center);
+		float length = Dot(d, d);
+		if (length > best)
+		{
+			best = length;
+			farthest = i;
+		}
+	}
+	XMFLOAT3 axis = Sub(mesh.Vertices[s[farthest]].pos, source.Center);
+	best = 0.0f;
+	for (ULONG i = 0; i < source.VertexCount; i++)
+	{
+		XMFLOAT3 w = Cross(axis, Sub(mesh.Vertices[s[i]].pos, source.Center));
+		float area = Dot(w, w);
+		if (area > best)
+		{
+			best = area;
+			wide = i;
+		}
+	}
+
+	XMFLOAT3 from[3], to[3];
+	if (!Frame(source.Center, mesh.Vertices[s[farthest]].pos, mesh.Vertices[s[wide]].pos, from) ||
+		!Frame(candidate.Center, mesh.Vertices[c[farthest]].pos, mesh.Vertices[c[wide]].pos, to))
+	{
+		return false;
+	}
+
+	// Row vector p * R maps from[k] onto to[k]: R[i][j] is the sum of
+	// from[k][i] * to[k][j].
+	float r[3][3];
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			r[i][j] = (&from[0].x)[i] * (&to[0].x)[j] + (&from[1].x)[i] * (&to[1].x)[j] + (&from[2].x)[i] * (&to[2].x)[j];
+		}
+	}
+
+	XMFLOAT3 t = candidate.Center;
+	t.x -= source.Center.x * r[0][0] + source.Center.y * r[1][0] + source.Center.z * r[2][0];
+	t.y -= source.Center.x * r[0][1] + source.Center.y * r[1][1] + source.Center.z * r[2][1];
+	t.z -= source.Center.x * r[0][2] + source.Center.y * r[1][2] + source.Center.z * r[2][2];
+
+	float positionLimit = options.PositionTolerance * source.Radius;
+	positionLimit *= positionLimit;
+	for (ULONG i = 0; i < source.VertexCount; i++)
+	{
+		const vertexData& a = mesh.Vertices[s[i]];
+		const vertexData& b = mesh.Vertices[c[i]];
+
+		XMFLOAT3 p(a.pos.x * r[0][0] + a.pos.y * r[1][0] + a.pos.z * r[2][0] + t.x,
+			a.pos.x * r[0][1] + a.pos.y * r[1][1] + a.pos.z * r[2][1] + t.y,
+			a.pos.x * r[0][2] + a.pos.y * r[1][2] + a.pos.z * r[2][2] + t.z);
+		XMFLOAT3 n(a.Normal.x * r[0][0] + a.Normal.y * r[1][0] + a.Normal.z * r[2][0],
+			a.Normal.x * r[0][1] + a.Normal.y * r[1][1] + a.Normal.z * r[2][1],
+			a.Normal.x * r[0][2] + a.Normal.y * r[1][2] + a.Normal.z * r[2][2]);
+
+		XMFLOAT3 dp = Sub(p, b.pos);
+		XMFLOAT3 dn = Sub(n, b.Normal);
+		if (Dot(dp, dp) > positionLimit ||
+			fabs(dn.x) > options.NormalTolerance || fabs(dn.y) > options.NormalTolerance || fabs(dn.z) > options.NormalTolerance ||
+			a.tex.x != b.tex.x || a.tex.y != b.tex.y)
+		{
+			return false;
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			transform.m[i][j] = r[i][j];
+		}
+	}
+	transform.m[3][0] = t.x;
+	transform.m[3][1] = t.y;
+	transform.m[3][2] = t.z;
+
+	return true;
+}
+
+
+bool FindInstances(Mesh& mesh, const InstanceOptions& options, Arena& arena)
+{
+	UINT objects = mesh.ObjectCount;
+	ULONG triangleTotal = mesh.IndexCount / 3;
+
+	// Skinned subsets are posed by their bones, not placed.
+	mesh.Instances = 0;
+	mesh.InstanceCount = 0;
+	if (objects < 2 || mesh.Skin)
+	{
+		return true;
+	}
+
+	SubsetTriangles groups;
+	if (!GroupTrianglesBySubset(mesh, arena, groups))
+	{
+		return false;
+	}
+
+	SubsetGeometry* geometry = arena.NewArray<SubsetGeometry>(objects);
+	ULONG* vertices = arena.NewArray<ULONG>(mesh.VertexCount);
+	ULONG* local = arena.NewArray<ULONG>(mesh.VertexCount);
+	ULONG* triangles = arena.NewArray<ULONG>(triangleTotal * 3);
+	if (!geometry || !vertices || !local || !triangles)
+	{
+		return false;
+	}
+
+	for (UINT i = 0; i < objects; i++)
+	{
+		geometry[i].VertexCount = 0;
+		geometry[i].TriangleCount = 0;
+		geometry[i].Closed = true;
+	}
+
+	// Group the vertices by subset. Subsets sharing vertices with another can
+	// not be moved on their own.
+	for (ULONG i = 0; i < mesh.VertexCount; i++)
+	{
+		UINT id = mesh.Vertices[i].ID;
+		if (id < objects)
+		{
+			local[i] = geometry[id].VertexCount++;
+		}
+	}
+	for (UINT i = 0; i < objects; i++)
+	{
+		geometry[i].TriangleCount = groups.Start[i + 1] - groups.Start[i];
+	}
+	for (ULONG t = 0; t < triangleTotal; t++)
+	{
+		const ULONG* index = mesh.Indices + t * 3;
+		UINT id = TriangleSubset(mesh, t);
+		for (int k = 1; k < 3; k++)
+		{
+			UINT other = mesh.Vertices[index[k]].ID;
+			if (other != id)
+			{
+				if (id < objects)
+				{
+					geometry[id].Closed = false;
+				}
+				if (other < objects)
+				{
+					geometry[other].Closed = false;
+				}
+			}
+		}
+	}
+
+	ULONG vertexOffset = 0, triangleOffset = 0;
+	for (UINT i = 0; i < objects; i++)
+	{
+		geometry[i].VertexStart = vertexOffset;
+		geometry[i].TriangleStart = triangleOffset;
+		vertexOffset += geometry[i].VertexCount;
+		triangleOffset += geometry[i].TriangleCount;
+		geometry[i].VertexCount = 0;
+		geometry[i].TriangleCount = 0;
+	}
+	for (ULONG i = 0; i < mesh.VertexCount; i++)
+	{
+		UINT id = mesh.Vertices[i].ID;
+		if (id < objects)
+		{
+			SubsetGeometry& g = geometry[id];
+			vertices[g.VertexStart + g.VertexCount++] = i;
+		}
+	}
+	for (UINT i = 0; i < objects; i++)
+	{
+		SubsetGeometry& g = geometry[i];
+		for (ULONG j = groups.Start[i]; j < groups.Start[i + 1]; j++)
+		{
+			const ULONG* index = mesh.Indices + groups.Order[j] * 3;
+			ULONG* out = triangles + (g.TriangleStart + g.TriangleCount++) * 3;
+			out[0] = local[index[0]];
+			out[1] = local[index[1]];
+			out[2] = local[index[2]];
+		}
+	}
+
+	// Hash the subsets that can be moved and sort them so candidates with the
+	// same hash sit next to each other.
+	HashedSubset* order = arena.NewArray<HashedSubset>(objects);
+	if (!order)
+	{
+		return false;
+	}
+
+	UINT hashed = 0;
+	for (UINT i = 0; i < objects; i++)
+	{
+		SubsetGeometry& g = geometry[i];
+		if (!g.Closed || g.VertexCount < 3 || !g.TriangleCount)
+		{
+			continue;
+		}
+
+		// Large subsets far from the origin need the wider sum.
+		double center[3] = { 0.0, 0.0, 0.0 };
+		for (ULONG j = 0; j < g.VertexCount; j++)
+		{
+			const XMFLOAT3& p = mesh.Vertices[vertices[g.VertexStart + j]].pos;
+			center[0] += p.x;
+			center[1] += p.y;
+			center[2] += p.z;
+		}
+		g.Center = XMFLOAT3((float)(center[0] / g.VertexCount), (float)(center[1] / g.VertexCount), (float)(center[2] / g.VertexCount));
+		g.Radius = 0.0f;
+		for (ULONG j = 0; j < g.VertexCount; j++)
+		{
+			XMFLOAT3 d = Sub(mesh.Vertices[vertices[g.VertexStart + j]].pos, g.Center);
+			g.Radius = max(g.Radius, Dot(d, d));
+		}
+		g.Radius = sqrt(g.Radius);
+		if (g.Radius == 0.0f)
+		{
+			continue;
+		}
+
+		g.Hash = HashSubset(mesh, g, vertices, triangles);
+		order[hashed].Hash = g.Hash;
+		order[hashed].Radius = g.Radius;
+		order[hashed].Subset = i;
+		hashed++;
+	}
+	sort(order, order + hashed);
+
+	// Within a run of equal hashes, sorted by radius, a subset is compared with
+	// the earlier ones of about its size. The first it matches that is not a
+	// copy itself becomes its source.
+	UINT* sourceOf = arena.NewArray<UINT>(objects);
+	InstanceDesc* instances = arena.NewArray<InstanceDesc>(objects);
+	if (!sourceOf || !instances)
+	{
+		return false;
+	}
+
+	for (UINT i = 0; i < objects; i++)
+	{
+		sourceOf[i] = i;
+	}
+
+	UINT instanceCount = 0;
+	for (UINT i = 1; i < hashed; i++)
+	{
+		UINT candidate = order[i].Subset;
+		float reach = order[i].Radius * (1.0f - options.PositionTolerance * 2.0f);
+		for (UINT j = i; j-- > 0 && order[j].Hash == order[i].Hash && order[j].Radius >= reach; )
+		{
+			UINT source = order[j].Subset;
+			if (sourceOf[source] != source)
+			{
+				continue;
+			}
+
+			XMFLOAT4X3 transform;
+			if (MatchSubsets(mesh, geometry[source], geometry[candidate], vertices, triangles, options, transform))
+			{
+				sourceOf[candidate] = source;
+				instances[instanceCount].SubsetID = source;
+				instances[instanceCount].ObjectID = candidate;
+				instances[instanceCount].Transform = transform;
+				instanceCount++;
+				break;
+			}
+		}
+	}
+
+	if (!instanceCount)
+	{
+		return true;
+	}
+
+	// Drop the geometry of the instanced subsets. Kept vertices and triangles
+	// only ever move forward, so the mesh is compacted in place.
+	static const ULONG DROPPED = 0xffffffff;
+	ULONG* remap = local;
+	ULONG vertexCount = 0;
+	for (ULONG i = 0; i < mesh.VertexCount; i++)
+	{
+		UINT id = mesh.Vertices[i].ID;
+		if (id < objects && sourceOf[id] != id)
+		{
+			remap[i] = DROPPED;
+			continue;
+		}
+
+		remap[i] = vertexCount;
+		mesh.Vertices[vertexCount++] = mesh.Vertices[i];
+	}
+
+	ULONG indexCount = 0;
+	for (ULONG t = 0; t < triangleTotal; t++)
+	{
+		const ULONG* index = mesh.Indices + t * 3;
+		if (remap[index[0]] == DROPPED)
+		{
+			continue;
+		}
+
+		ULONG a = remap[index[0]], b = remap[index[1]], c = remap[index[2]];
+		mesh.Indices[indexCount++] = a;
+		mesh.Indices[indexCount++] = b;
+		mesh.Indices[indexCount++] = c;
+	}
+
+	// Subset ranges follow the compacted arrays; instanced subsets are empty.
+	if (mesh.Subsets)
+	{
+		for (UINT i = 0; i < objects; i++)
+		{
+			mesh.Subsets[i].VertexStart = 0;
+			mesh.Subsets[i].VertexCount = 0;
+			mesh.Subsets[i].FaceStart = 0;
+			mesh.Subsets[i].FaceCount = 0;
+		}
+		for (ULONG i = 0; i < vertexCount; i++)
+		{
+			UINT id = mesh.Vertices[i].ID;
+			if (id < objects)
+			{
+				SubsetTableDesc& subset = mesh.Subsets[id];
+				if (!subset.VertexCount)
+				{
+					subset.VertexStart = i;
+				}
+				subset.VertexCount = i - subset.VertexStart + 1;
+			}
+		}
+		for (ULONG t = 0; t < indexCount / 3; t++)
+		{
+			UINT id = TriangleSubset(mesh, t);
+			if (id < objects)
+			{
+				SubsetTableDesc& subset = mesh.Subsets[id];
+				if (!subset.FaceCount)
+				{
+					subset.FaceStart = t;
+				}
+				subset.FaceCount = t - subset.FaceStart + 1;
+			}
+		}
+	}
+
+	mesh.VertexCount = vertexCount;
+	mesh.IndexCount = indexCount;
+	mesh.Instances = instances;
+	mesh.InstanceCount = instanceCount;
+
+	return true;
+}
@@ -0,0 +1,536 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: M3DParser.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <climits>
+#include "ModelParser.h"
+#include "MemoryStream.h"
+using namespace DirectX;
+using namespace std;
+
+
+// The fewest bytes each entry can take: the labels the reader skips, plus
+// one digit and a separator for each index of a triangle.
+static const unsigned long long M3D_MIN_MATERIAL = 104;
+static const unsigned long long M3D_MIN_SUBSET = 62;
+static const unsigned long long M3D_MIN_VERTEX = 39;
+static const unsigned long long M3D_MIN_TRIANGLE = 5;
+
+
+void readData(XMFLOAT4* xm, istream* s)
+{
+	char temp;
+	(*s) >> xm->x;
+	(*s).get(temp);
+	(*s) >> xm->y;
+	(*s).get(temp);
+	(*s) >> xm->z;
+	(*s).get(temp);
+	(*s) >> xm->w;
+}
+
+void readData(XMFLOAT3* xm, istream* s)
+{
+	char temp;
+	(*s) >> xm->x;
+	(*s).get(temp);
+	(*s) >> xm->y;
+	(*s).get(temp);
+	(*s) >> xm->z;
+}
+
+void readData(XMFLOAT2* xm, istream* s)
+{
+	char temp;
+	(*s) >> xm->x;
+	(*s).get(temp);
+	(*s) >> xm->y;
+}
+
+void readData(float* xm, istream* s)
+{
+	(*s) >> (*xm);
+}
+
+
+// Bytes left to read, or as many as could be when the stream cannot seek.
+unsigned long long RemainingBytes(istream& fin)
+{
+	streamoff position = fin.tellg();
+	if (position < 0)
+	{
+		return ULLONG_MAX;
+	}
+
+	fin.seekg(0, ios_base::end);
+	streamoff end = fin.tellg();
+	fin.seekg(position);
+	return end > position ? (unsigned long long)(end - position) : 0;
+}
+
+
+// Bytes read since mark, moving mark to the current position.
+unsigned long long SectionBytes(istream& fin, streamoff& mark)
+{
+	streamoff position = fin.tellg();
+	if (position < 0)
+	{
+		return 0;
+	}
+
+	unsigned long long bytes = position - mark;
+	mark = position;
+	return bytes;
+}
+
+
+bool ParseM3D(const char* data, size_t size, Arena& arena, Mesh& mesh, ConversionStats* stats, const CoordinateSystem* target)
+{
+	MemoryStream fin(data, size);
+
+	if (!M3DReadFileCounts(fin, arena, mesh, stats))
+	{
+		return false;
+	}
+
+	// Indices past the vertices, NaN or infinite attributes and triangles
+	// without area are dropped before anything reads them.
+	StageTimer validate(stats, STAGE_VALIDATE, arena);
+	if (!SanitizeMesh(mesh, arena, stats ? &stats->Validation : 0))
+	{
+		return false;
+	}
+	validate.Stop(sizeof(vertexData) * mesh.VertexCount + sizeof(ULONG) * mesh.IndexCount);
+
+	StageTimer convert(stats, STAGE_CONVERT, arena);
+	CoordinateSystem from, to;
+	M3DCoordinateSystem(from);
+	DefaultCoordinateSystem(to);
+	ConvertCoordinates(mesh, from, target ? *target : to);
+	convert.Stop(sizeof(vertexData) * mesh.VertexCount + sizeof(ULONG) * mesh.IndexCount);
+
+	return true;
+}
+
+
+bool M3DReadFileCounts(istream& fin, Arena& arena, Mesh& mesh, ConversionStats* stats)
+{
+	UINT vertexCount, faceCount, objectCount, boneCount;
+	char input;
+	streamoff mark = stats ? (streamoff)fin.tellg() : 0;
+	StageTimer header(stats, STAGE_M3D_HEADER, arena);
+	// Initialize the counts.
+	vertexCount = 0;
+	faceCount = 0;
+	objectCount = 0;
+	boneCount = 0;
+
+	// Every scan stops at the end of the stream, so a truncated file fails
+	// instead of spinning.
+	fin.get(input);
+	while (input != '#' && fin)
+	{
+		fin.get(input);
+	}
+
+	// Read Material count
+	for (int k = 0; k < 10; k++)
+		fin.get(input);
+
+	fin >> objectCount;
+
+	// Read Vertex count
+	for (int k = 0; k < 10; k++)
+		fin.get(input);
+
+	fin >> vertexCount;
+
+	// Read FaceCount count
+	for (int k = 0; k < 11; k++)
+		fin.get(input);
+
+	fin >> faceCount;
+
+	// Read Bone count
+	for (int k = 0; k < 7; k++)
+		fin.get(input);
+
+	fin >> boneCount;
+	if (!fin || faceCount > UINT_MAX / 3)
+	{
+		return false;
+	}
+
+	// Every material, subset, vertex and triangle takes at least its labels
+	// and separators, so counts the rest of the file cannot hold are lies
+	// that would otherwise be allocated for.
+	unsigned long long needed = (unsigned long long)objectCount * (M3D_MIN_MATERIAL + M3D_MIN_SUBSET) +
+		(unsigned long long)vertexCount * M3D_MIN_VERTEX + (unsigned long long)faceCount * M3D_MIN_TRIANGLE;
+	if (needed > RemainingBytes(fin))
+	{
+		if (stats)
+		{
+			stats->Validation.ImpossibleCounts++;
+		}
+		return false;
+	}
+
+	SubsetTableDesc* sS = mesh.Subsets = arena.NewArray<SubsetTableDesc>(objectCount);
+	MatrialDesc* pM = mesh.Materials = arena.NewArray<MatrialDesc>(objectCount);
+	unsigned int* tSB = arena.NewArray<unsigned int>(objectCount);
+	unsigned int* tSN = arena.NewArray<unsigned int>(objectCount);
+	string* tB = arena.NewArray<string>(objectCount);
+	string* tN = arena.NewArray<string>(objectCount);
+	if (!sS || !pM || !tSB || !tSN || !tB || !tN)
+	{
+		return false;
+	}
+
+	header.Stop(stats ? SectionBytes(fin, mark) : 0);
+	StageTimer materials(stats, STAGE_M3D_MATERIALS, arena);
+
+	while (input != '*' && fin)
+	{
+		fin.get(input);
+	}
+
+	for (int k = 0; k < 30; k++)
+		fin.get(input);
+
+	while (input == '*' && fin)
+	{
+		fin.get(input);
+	}
+	if (!fin)
+	{
+		return false;
+	}
+
+	for (UINT i = 0; i < objectCount; i++)
+	{
+		// Read Ambient
+		for (int k = 0; k < 9; k++)
+			fin.get(input);
+
+		readData(&pM[i].Ambient, &fin);
+
+		// Read Diffuse
+		for (int k = 0; k < 9; k++)
+			fin.get(input);
+
+		readData(&pM[i].Diffuse, &fin);
+
+		// Read Specular
+		for (int k = 0; k < 11; k++)
+			fin.get(input);
+
+		readData(&pM[i].Specular, &fin);
+
+		// Read Specular power
+		for (int k = 0; k < 11; k++)
+			fin.get(input);
+
+		readData(&pM[i].SpecPower, &fin);
+
+		// Read Reflectivity
+		for (int k = 0; k < 14; k++)
+			fin.get(input);
+
+		readData(&pM[i].Reflectivity, &fin);
+
+		// Read AlphaClip
+		for (int k = 0; k < 11; k++)
+			fin.get(input);
+
+		readData(&pM[i].AlphaClip, &fin);
+
+		// Read DiffuseMap
+		for (int k = 0; k < 27; k++)
+			fin.get(input);
+
+		getline(fin, tB[i]);
+		tSB[i] = tB[i].size() + 1;
+
+		// Read NormalMap
+		for (int k = 0; k < 11; k++)
+			fin.get(input);
+
+		getline(fin, tN[i]);
+		tSN[i] = tN[i].size() + 1;
+
+		fin.get(input);
+	}
+
+
+
+	materials.Stop(stats ? SectionBytes(fin, mark) : 0);
+	StageTimer subsets(stats, STAGE_M3D_SUBSETS, arena);
+
+	while (input != '*' && fin)
+	{
+		fin.get(input);
+	}
+
+	for (int k = 0; k < 30; k++)
+		fin.get(input);
+
+	while (input == '*' && fin)
+	{
+		fin.get(input);
+	}
+	if (!fin)
+	{
+		return false;
+	}
+
+	for (UINT i = 0; i < objectCount; i++)
+	{
+		// Read SubsetID
+		for (int k = 0; k < 10; k++)
+			fin.get(input);
+
+		fin >> sS[i].SubsetID;
+
+		// Read VertexStart
+		for (int k = 0; k <  14; k++)
+			fin.get(input);
+
+		fin >> sS[i].VertexStart;
+
+		// Read VertexCount
+		for (int k = 0; k <  14; k++)
+			fin.get(input);
+
+		fin >> sS[i].VertexCount;
+
+		// Read FaceStart
+		for (int k = 0; k <  12; k++)
+			fin.get(input);
+
+		fin >> sS[i].FaceStart;
+
+		// Read FaceCount
+		for (int k = 0; k <  12; k++)
+			fin.get(input);
+
+		fin >> sS[i].FaceCount;
+
+		// The vertex section is read straight into the ranges named here.
+		if (!fin || sS[i].VertexStart > vertexCount || sS[i].VertexCount > vertexCount - sS[i].VertexStart)
+		{
+			return false;
+		}
+	}
+
+	subsets.Stop(stats ? SectionBytes(fin, mark) : 0);
+	StageTimer vertices(stats, STAGE_M3D_VERTICES, arena);
+
+	while (input != '*' && fin)
+	{
+		fin.get(input);
+	}
+
+	for (int k = 0; k <  30; k++)
+		fin.get(input);
+
+	while (input == '*' && fin)
+	{
+		fin.get(input);
+	}
+	if (!fin)
+	{
+		return false;
+	}
+
+	vertexData* Vertices = mesh.Vertices = arena.NewArray<vertexData>(vertexCount);
+	XMFLOAT4 tangent;
+	if (!Vertices)
+	{
+		return false;
+	}
+
+	// Models without bones carry blend data too, but there is nothing to skin.
+	SkinVertex* skin = 0;
+	if (boneCount)
+	{
+		skin = arena.NewArray<SkinVertex>(vertexCount);
+		if (!skin)
+		{
+			return false;
+		}
+	}
+
+	for (UINT j = 0; j < objectCount; j++)
+	{
+		for (ULONG i = sS[j].VertexStart; i < sS[j].VertexCount + sS[j].VertexStart; i++)
+		{
+			// Read Position
+			for (int k = 0; k < 10; k++)
+				fin.get(input);
+
+			readData(&Vertices[i].pos, &fin);
+
+			// Read Tangent
+			for (int k = 0; k < 9; k++)
+				fin.get(input);
+
+			readData(&tangent, &fin);
+
+			// Read Normal
+			for (int k = 0; k < 8; k++)
+				fin.get(input);
+
+			readData(&Vertices[i].Normal, &fin);
+
+			// Read Tex-Coords
+			for (int k = 0; k < 12; k++)
+				fin.get(input);
+
+			readData(&Vertices[i].tex, &fin);
+
+
+			if (skin)
+			{
+				// Read BlendWeights
+				for (int k = 0; k < 14; k++)
+					fin.get(input);
+
+				readData(&skin[i].BlendWeights, &fin);
+
+				// Read BlendIndices
+				for (int k = 0; k < 14; k++)
+					fin.get(input);
+
+				for (int k = 0; k < 4; k++)
+				{
+					// An index is kept in a byte and must name one of the bones.
+					UINT bone;
+					fin >> bone;
+					if (!fin || bone > 255 || bone >= boneCount)
+					{
+						return false;
+					}
+					skin[i].BlendIndices[k] = (unsigned char)bone;
+				}
+
+				fin.get(input);
+				while (input != '\n' && fin)
+				{
+					fin.get(input);
+				}
+			}
+			else
+			{
+				// Skip Blend
+				fin.get(input);
+				fin.get(input);
+				while (input != '\n' && fin)
+				{
+					fin.get(input);
+				}
+				fin.get(input);
+				while (input != '\n' && fin)
+				{
+					fin.get(input);
+				}
+			}
+
+
+
+			Vertices[i].ID = j;
+			if (!fin)
+			{
+				return false;
+			}
+
+
+		}
+
+
+
+	}
+
+	vertices.Stop(stats ? SectionBytes(fin, mark) : 0);
+	StageTimer triangles(stats, STAGE_M3D_TRIANGLES, arena);
+
+	while (input != '*' && fin)
+	{
+		fin.get(input);
+	}
+
+	for (int k = 0; k < 30; k++)
+		fin.get(input);
+
+	while (input == '*' && fin)
+	{
+		fin.get(input);
+	}
+	if (!fin)
+	{
+		return false;
+	}
+
+
+	ULONG* Indices = mesh.Indices = arena.NewArray<ULONG>(faceCount * 3);
+	ULONG index = 0;
+	if (!Indices)
+	{
+		return false;
+	}
+	for (ULONG i = 0; i < faceCount; i++)
+	{
+		fin >> Indices[index];
+		fin.get(input);
+		index++;
+
+		fin >> Indices[index];
+		fin.get(input);
+		index++;
+
+		fin >> Indices[index];
+		fin.get(input);
+		index++;
+
+		// Only the last index may run into the end of the file.
+		if (!fin && !(fin.eof() && i + 1 == faceCount))
+		{
+			return false;
+		}
+	}
+
+	triangles.Stop(stats ? SectionBytes(fin, mark) : 0);
+
+	mesh.VertexCount = vertexCount;
+	mesh.IndexCount = faceCount * 3;
+	mesh.ObjectCount = objectCount;
+	mesh.TextureSize = tSB;
+	mesh.Instances = 0;
+	mesh.InstanceCount = 0;
+	mesh.Skin = skin;
+	mesh.BoneCount = boneCount;
+	mesh.Palettes = 0;
+	mesh.PaletteBones = 0;
+	mesh.PaletteBoneCount = 0;
+	mesh.Hulls = 0;
+	mesh.HullCount = 0;
+	mesh.HullVertices = 0;
+	mesh.HullVertexCount = 0;
+	mesh.HullIndices = 0;
+	mesh.HullIndexCount = 0;
+	mesh.TextureName = arena.NewArray<const char*>(objectCount);
+	if (!mesh.TextureName)
+	{
+		return false;
+	}
+
+	for (UINT i = 0; i < objectCount; i++)
+	{
+		mesh.TextureName[i] = tB[i].c_str();
+	}
+
+	return true;
+}
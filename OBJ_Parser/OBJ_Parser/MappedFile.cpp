@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MappedFile.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile()
+{
+	m_data = 0;
+	m_size = 0;
+#ifdef _WIN32
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	m_file = 0;
+#endif
+	m_mapping = 0;
+}
+
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+
+bool MappedFile::Open(const char* filename)
+{
+	Close();
+
+#ifdef _WIN32
+	m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size))
+	{
+		Close();
+		return false;
+	}
+	m_size = (size_t)size.QuadPart;
+
+	// An empty file cannot be mapped but is still a valid, empty view.
+	if (m_size)
+	{
+		m_mapping = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+		m_data = m_mapping ? (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+		if (!m_data)
+		{
+			Close();
+			return false;
+		}
+	}
+#else
+	int file = open(filename, O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(file, &info) != 0)
+	{
+		close(file);
+		return false;
+	}
+	m_size = (size_t)info.st_size;
+
+	// An empty file cannot be mapped but is still a valid, empty view.
+	if (m_size)
+	{
+		void* data = mmap(0, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data == MAP_FAILED)
+		{
+			close(file);
+			m_size = 0;
+			return false;
+		}
+		m_data = (const char*)data;
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	close(file);
+#endif
+
+	return true;
+}
+
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+	}
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = 0;
+#else
+	if (m_data)
+	{
+		munmap((void*)m_data, m_size);
+	}
+#endif
+	m_data = 0;
+	m_size = 0;
+}
@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MappedFile.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: MappedFile
+// Maps a whole file read-only. Pages are only read when they are touched, so
+// opening a large pack costs one open() and the models that are used. The
+// platform handles stay in MappedFile.cpp so windows.h does not meet the
+// ULONG of ModelParser.h.
+////////////////////////////////////////////////////////////////////////////////
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char* filename);
+	void Close();
+
+	const char* Data() const { return m_data; }
+	size_t Size() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+private:
+	const char* m_data;
+	size_t m_size;
+	void* m_file;
+	void* m_mapping;
+};
+
+#endif
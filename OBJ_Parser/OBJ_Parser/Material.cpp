@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Material.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <iostream>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include "ModelParser.h"
+using namespace DirectX;
+using namespace std;
+
+
+/////////////
+// GLOBALS //
+/////////////
+// Parsed .mtl libraries keyed by path, kept for the whole process so shared libraries are only read once.
+map<string, MtlLibrary> g_MtlCache;
+// Every library asked for since TakeMaterialLibrariesUsed last emptied it, read or not.
+set<string> g_MtlUsed;
+
+
+void DefaultMaterial(MatrialDesc* m)
+{
+	// The defaults the .mtl format specifies for a material that leaves them out.
+	m->Ambient = XMFLOAT3(0.2f, 0.2f, 0.2f);
+	m->Diffuse = XMFLOAT3(0.8f, 0.8f, 0.8f);
+	m->Specular = XMFLOAT3(1.0f, 1.0f, 1.0f);
+	m->SpecPower = 0.0f;
+	m->Reflectivity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	m->AlphaClip = 0.0f;
+}
+
+
+void ClearMaterialCache()
+{
+	// A library changed on disk. They are cheap to read again, and a .obj may
+	// name one by any path, so all of them go.
+	g_MtlCache.clear();
+}
+
+
+void TakeMaterialLibrariesUsed(vector<string>& libraries)
+{
+	libraries.assign(g_MtlUsed.begin(), g_MtlUsed.end());
+	g_MtlUsed.clear();
+}
+
+
+const MtlLibrary* LoadMaterialLibrary(const string& filename)
+{
+	ifstream fin;
+	string line, keyword;
+	MtlDesc* current = 0;
+
+	// A library that could not be opened still matters once it is saved.
+	g_MtlUsed.insert(filename);
+
+	// Each library is parsed once per batch.
+	map<string, MtlLibrary>::iterator cached = g_MtlCache.find(filename);
+	if (cached != g_MtlCache.end())
+	{
+		return &cached->second;
+	}
+
+	// Open the file.
+	fin.open(filename);
+
+	// Check if it was successful in opening the file.
+	if (fin.fail() == true)
+	{
+		cout << "Material library " << filename << " could not be opened." << endl;
+		return 0;
+	}
+
+	MtlLibrary& lib = g_MtlCache[filename];
+
+	while (getline(fin, line))
+	{
+		istringstream ls(line);
+		keyword.clear();
+		ls >> keyword;
+
+		if (keyword == "newmtl")
+		{
+			string name;
+			getline(ls >> ws, name);
+			if (!name.empty() && name[name.size() - 1] == '\r')
+			{
+				name.erase(name.size() - 1);
+			}
+
+			current = &lib[name];
+			DefaultMaterial(&current->Material);
+			continue;
+		}
+
+		if (!current)
+		{
+			continue;
+		}
+
+		if (keyword == "Ka")
+		{
+			ls >> current->Material.Ambient.x >> current->Material.Ambient.y >> current->Material.Ambient.z;
+		}
+		else if (keyword == "Kd")
+		{
+			ls >> current->Material.Diffuse.x >> current->Material.Diffuse.y >> current->Material.Diffuse.z;
+		}
+		else if (keyword == "Ks")
+		{
+			ls >> current->Material.Specular.x >> current->Material.Specular.y >> current->Material.Specular.z;
+		}
+		else if (keyword == "Ns")
+		{
+			ls >> current->Material.SpecPower;
+		}
+		else if (keyword == "d" || keyword == "Tr")
+		{
+			// Anything less than fully opaque is alpha clipped, like the m3d AlphaClip flag.
+			float dissolve = 1.0f;
+			ls >> dissolve;
+			if (keyword == "Tr")
+			{
+				dissolve = 1.0f - dissolve;
+			}
+			current->Material.AlphaClip = dissolve < 1.0f ? 1.0f : 0.0f;
+		}
+		else if (keyword == "map_Kd" || keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump")
+		{
+			// Map statements may carry options before the file name, which always comes last.
+			string map, token;
+			while (ls >> token)
+			{
+				map = token;
+			}
+
+			if (keyword == "map_Kd")
+			{
+				current->DiffuseMap = map;
+			}
+			else
+			{
+				current->NormalMap = map;
+			}
+		}
+	}
+
+	// Close the file.
+	fin.close();
+
+	return &lib;
+}
@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MemoryStream.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MEMORYSTREAM_H_
+#define _MEMORYSTREAM_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <istream>
+#include <streambuf>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: MemoryStream
+// Reads a buffer in place through the istream interface the parsers use, so
+// parsing from memory needs no copy of the data.
+////////////////////////////////////////////////////////////////////////////////
+class MemoryStream : public std::istream
+{
+private:
+	class Buffer : public std::streambuf
+	{
+	public:
+		Buffer(const char* data, size_t size)
+		{
+			char* begin = const_cast<char*>(data);
+			setg(begin, begin, begin + size);
+		}
+
+	protected:
+		// Lets tellg() and seekg() report and move the read position.
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+		{
+			char* base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr();
+			if (!(which & std::ios_base::in) || base + off < eback() || base + off > egptr())
+			{
+				return pos_type(off_type(-1));
+			}
+
+			setg(eback(), base + off, egptr());
+			return pos_type(gptr() - eback());
+		}
+
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which)
+		{
+			return seekoff(off_type(pos), std::ios_base::beg, which);
+		}
+	};
+
+public:
+	MemoryStream(const char* data, size_t size) : std::istream(0), m_buffer(data, size)
+	{
+		rdbuf(&m_buffer);
+	}
+
+private:
+	Buffer m_buffer;
+};
+
+#endif
@@ -0,0 +1,376 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshAnalysis.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstring>
+#include <cmath>
+#include "ModelParser.h"
+using namespace std;
+
+
+void DefaultAnalysisOptions(AnalysisOptions& options)
+{
+	options.FifoCacheSize = 16;
+	options.LruCacheSize = 32;
+	options.FetchCacheBytes = 8 * 1024;
+	options.FetchLineBytes = 64;
+	options.OverdrawResolution = 256;
+}
+
+
+// FIFO post-transform cache. A vertex is still cached while fewer than
+// cacheSize misses happened since it was loaded.
+ULONG SimulateFifo(const ULONG* indices, ULONG indexCount, UINT cacheSize, ULONG* stamps, ULONG vertexCount)
+{
+	ULONG misses = 0;
+
+	for (ULONG i = 0; i < indexCount; i++)
+	{
+		ULONG v = indices[i];
+		if (v >= vertexCount)
+		{
+			continue;
+		}
+
+		if (stamps[v] == 0 || misses - stamps[v] >= cacheSize)
+		{
+			misses++;
+			stamps[v] = misses;
+		}
+	}
+
+	return misses;
+}
+
+
+// LRU post-transform cache kept as a small most-recent-first list.
+ULONG SimulateLru(const ULONG* indices, ULONG indexCount, UINT cacheSize, ULONG* cache)
+{
+	ULONG misses = 0;
+	UINT used = 0;
+
+	for (ULONG i = 0; i < indexCount; i++)
+	{
+		ULONG v = indices[i];
+		UINT slot = 0;
+		while (slot < used && cache[slot] != v)
+		{
+			slot++;
+		}
+
+		if (slot == used)
+		{
+			misses++;
+			if (used < cacheSize)
+			{
+				used++;
+			}
+			slot = used - 1;
+		}
+
+		memmove(cache + 1, cache, slot * sizeof(ULONG));
+		cache[0] = v;
+	}
+
+	return misses;
+}
+
+
+// Bytes pulled through a direct mapped cache of lineBytes sized lines while
+// fetching every indexed vertex.
+unsigned long long SimulateFetch(const ULONG* indices, ULONG indexCount, ULONG vertexCount, const AnalysisOptions& options, unsigned long long* lines)
+{
+	UINT lineCount = options.FetchCacheBytes / options.FetchLineBytes;
+	unsigned long long fetched = 0;
+
+	for (UINT i = 0; i < lineCount; i++)
+	{
+		lines[i] = ~0ull;
+	}
+
+	for (ULONG i = 0; i < indexCount; i++)
+	{
+		if (indices[i] >= vertexCount)
+		{
+			continue;
+		}
+
+		unsigned long long start = (unsigned long long)indices[i] * sizeof(vertexData);
+		unsigned long long end = start + sizeof(vertexData) - 1;
+		for (unsigned long long line = start / options.FetchLineBytes; line <= end / options.FetchLineBytes; line++)
+		{
+			unsigned long long& slot = lines[line % lineCount];
+			if (slot != line)
+			{
+				slot = line;
+				fetched += options.FetchLineBytes;
+			}
+		}
+	}
+
+	return fetched;
+}
+
+
+// Rasterizes the triangles orthographically along the six axis directions
+// with a depth test and returns shaded pixels over covered pixels. Back faces
+// are culled using the clockwise front faces the converter writes.
+float EstimateOverdraw(const vertexData* vertices, const ULONG* indices, ULONG indexCount, ULONG vertexCount, UINT resolution, float* depth)
+{
+	static const float axes[6][3][3] =
+	{
+		// right, up, forward
+		{ { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+		{ { -1, 0, 0 }, { 0, 1, 0 }, { 0, 0, -1 } },
+		{ { 0, 0, -1 }, { 0, 1, 0 }, { 1, 0, 0 } },
+		{ { 0, 0, 1 }, { 0, 1, 0 }, { -1, 0, 0 } },
+		{ { 1, 0, 0 }, { 0, 0, -1 }, { 0, 1, 0 } },
+		{ { 1, 0, 0 }, { 0, 0, 1 }, { 0, -1, 0 } },
+	};
+
+	unsigned long long shaded = 0, covered = 0;
+	if (indexCount < 3)
+	{
+		return 0.0f;
+	}
+
+	for (int view = 0; view < 6; view++)
+	{
+		const float* right = axes[view][0];
+		const float* up = axes[view][1];
+		const float* forward = axes[view][2];
+
+		// Fit the projected bounds to the grid.
+		float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+		for (ULONG i = 0; i < indexCount; i++)
+		{
+			if (indices[i] >= vertexCount)
+			{
+				continue;
+			}
+			const DirectX::XMFLOAT3& p = vertices[indices[i]].pos;
+			float x = p.x * right[0] + p.y * right[1] + p.z * right[2];
+			float y = p.x * up[0] + p.y * up[1] + p.z * up[2];
+			minX = x < minX ? x : minX;
+			maxX = x > maxX ? x : maxX;
+			minY = y < minY ? y : minY;
+			maxY = y > maxY ? y : maxY;
+		}
+		float extent = maxX - minX > maxY - minY ? maxX - minX : maxY - minY;
+		if (!(extent > 0.0f))
+		{
+			continue;
+		}
+		float scale = (resolution - 1) / extent;
+
+		for (UINT i = 0; i < resolution * resolution; i++)
+		{
+			depth[i] = 1e30f;
+		}
+
+		for (ULONG t = 0; t + 2 < indexCount; t += 3)
+		{
+			float sx[3], sy[3], sz[3];
+			bool valid = true;
+			for (int k = 0; k < 3; k++)
+			{
+				if (indices[t + k] >= vertexCount)
+				{
+					valid = false;
+					break;
+				}
+				const DirectX::XMFLOAT3& p = vertices[indices[t + k]].pos;
+				sx[k] = (p.x * right[0] + p.y * right[1] + p.z * right[2] - minX) * scale;
+				sy[k] = (p.x * up[0] + p.y * up[1] + p.z * up[2] - minY) * scale;
+				sz[k] = p.x * forward[0] + p.y * forward[1] + p.z * forward[2];
+			}
+			if (!valid)
+			{
+				continue;
+			}
+
+			// Clockwise on screen with y up has a negative area.
+			float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+			if (!(area < 0.0f))
+			{
+				continue;
+			}
+
+			int x0 = (int)floor(fmin(sx[0], fmin(sx[1], sx[2])));
+			int x1 = (int)ceil(fmax(sx[0], fmax(sx[1], sx[2])));
+			int y0 = (int)floor(fmin(sy[0], fmin(sy[1], sy[2])));
+			int y1 = (int)ceil(fmax(sy[0], fmax(sy[1], sy[2])));
+			x0 = x0 < 0 ? 0 : x0;
+			y0 = y0 < 0 ? 0 : y0;
+			x1 = x1 > (int)resolution - 1 ? resolution - 1 : x1;
+			y1 = y1 > (int)resolution - 1 ? resolution - 1 : y1;
+
+			for (int y = y0; y <= y1; y++)
+			{
+				for (int x = x0; x <= x1; x++)
+				{
+					float px = x + 0.5f, py = y + 0.5f;
+					float w0 = (sx[2] - sx[1]) * (py - sy[1]) - (sy[2] - sy[1]) * (px - sx[1]);
+					float w1 = (sx[0] - sx[2]) * (py - sy[2]) - (sy[0] - sy[2]) * (px - sx[2]);
+					float w2 = (sx[1] - sx[0]) * (py - sy[0]) - (sy[1] - sy[0]) * (px - sx[0]);
+					if (w0 > 0.0f || w1 > 0.0f || w2 > 0.0f)
+					{
+						continue;
+					}
+
+					float z = (w0 * sz[0] + w1 * sz[1] + w2 * sz[2]) / area;
+					float& stored = depth[y * resolution + x];
+					if (stored == 1e30f)
+					{
+						covered++;
+					}
+					if (z < stored)
+					{
+						stored = z;
+						shaded++;
+					}
+				}
+			}
+		}
+	}
+
+	return covered ? (float)shaded / covered : 0.0f;
+}
+
+
+// Working memory shared by every AnalyzeTriangles() call of a mesh. Stamps
+// are zero between calls.
+struct AnalysisScratch
+{
+	ULONG* Stamps;
+	ULONG* Lru;
+	unsigned long long* Lines;
+	float* Depth;
+};
+
+
+// Zeroes the stamps of the vertices these indices name, which are the only
+// ones a pass over them can have set.
+static void ClearStamps(const ULONG* indices, ULONG indexCount, ULONG vertexCount, ULONG* stamps)
+{
+	for (ULONG i = 0; i < indexCount; i++)
+	{
+		if (indices[i] < vertexCount)
+		{
+			stamps[indices[i]] = 0;
+		}
+	}
+}
+
+
+void AnalyzeTriangles(const SMFView& view, const ULONG* indices, ULONG indexCount, const AnalysisOptions& options, const AnalysisScratch& scratch, MeshMetrics& metrics)
+{
+	ULONG vertexCount = view.Head->VertexCount;
+	ULONG* stamps = scratch.Stamps;
+
+	// Unique vertices referenced by these triangles.
+	ULONG unique = 0;
+	for (ULONG i = 0; i < indexCount; i++)
+	{
+		if (indices[i] < vertexCount && !stamps[indices[i]])
+		{
+			stamps[indices[i]] = 1;
+			unique++;
+		}
+	}
+
+	metrics.Triangles = indexCount / 3;
+	metrics.Vertices = unique;
+
+	ClearStamps(indices, indexCount, vertexCount, stamps);
+	ULONG fifo = SimulateFifo(indices, indexCount, options.FifoCacheSize, stamps, vertexCount);
+	ClearStamps(indices, indexCount, vertexCount, stamps);
+	ULONG lruMisses = SimulateLru(indices, indexCount, options.LruCacheSize, scratch.Lru);
+	unsigned long long fetched = SimulateFetch(indices, indexCount, vertexCount, options, scratch.Lines);
+
+	metrics.AcmrFifo = metrics.Triangles ? (float)fifo / metrics.Triangles : 0.0f;
+	metrics.AtvrFifo = unique ? (float)fifo / unique : 0.0f;
+	metrics.AcmrLru = metrics.Triangles ? (float)lruMisses / metrics.Triangles : 0.0f;
+	metrics.AtvrLru = unique ? (float)lruMisses / unique : 0.0f;
+	metrics.Overfetch = unique ? (float)fetched / ((unsigned long long)unique * sizeof(vertexData)) : 0.0f;
+	metrics.FetchEfficiency = metrics.Overfetch > 0.0f ? 1.0f / metrics.Overfetch : 0.0f;
+	metrics.Overdraw = EstimateOverdraw(view.Vertices, indices, indexCount, vertexCount, options.OverdrawResolution, scratch.Depth);
+}
+
+
+bool AnalyzeMesh(const SMFView& view, const AnalysisOptions& options, Arena& arena, MeshMetrics** ppSubsets, MeshMetrics& total)
+{
+	const Header& head = *view.Head;
+	ULONG triangles = head.IndexCount / 3;
+
+	if (options.FetchLineBytes == 0 || options.FetchCacheBytes < options.FetchLineBytes || options.LruCacheSize == 0 || options.OverdrawResolution == 0)
+	{
+		return false;
+	}
+
+	// Triangles belong to the subset of their first vertex.
+	ULONG* counts = arena.NewArray<ULONG>(head.ObjectCount + 1);
+	ULONG* starts = arena.NewArray<ULONG>(head.ObjectCount + 1);
+	ULONG* sorted = arena.NewArray<ULONG>(triangles * 3);
+	MeshMetrics* subsets = *ppSubsets = arena.NewArray<MeshMetrics>(head.ObjectCount);
+	if (!counts || !starts || !sorted || !subsets)
+	{
+		return false;
+	}
+
+	// One set of working memory for every subset and the whole mesh.
+	AnalysisScratch scratch;
+	scratch.Stamps = arena.NewArray<ULONG>(head.VertexCount);
+	scratch.Lru = arena.NewArray<ULONG>(options.LruCacheSize);
+	scratch.Lines = arena.NewArray<unsigned long long>(options.FetchCacheBytes / options.FetchLineBytes);
+	scratch.Depth = arena.NewArray<float>((size_t)options.OverdrawResolution * options.OverdrawResolution);
+	if (!scratch.Stamps || !scratch.Lru || !scratch.Lines || !scratch.Depth)
+	{
+		return false;
+	}
+	memset(scratch.Stamps, 0, sizeof(ULONG) * head.VertexCount);
+
+	memset(counts, 0, sizeof(ULONG) * (head.ObjectCount + 1));
+	for (ULONG t = 0; t < triangles; t++)
+	{
+		ULONG v = view.Indices[t * 3];
+		UINT id = v < head.VertexCount ? view.Vertices[v].ID : head.ObjectCount;
+		counts[id < head.ObjectCount ? id : head.ObjectCount]++;
+	}
+
+	ULONG start = 0;
+	for (UINT i = 0; i <= head.ObjectCount; i++)
+	{
+		starts[i] = start;
+		start += counts[i] * 3;
+	}
+
+	for (ULONG t = 0; t < triangles; t++)
+	{
+		ULONG v = view.Indices[t * 3];
+		UINT id = v < head.VertexCount ? view.Vertices[v].ID : head.ObjectCount;
+		ULONG& dst = starts[id < head.ObjectCount ? id : head.ObjectCount];
+		memcpy(sorted + dst, view.Indices + t * 3, sizeof(ULONG) * 3);
+		dst += 3;
+	}
+
+	start = 0;
+	for (UINT i = 0; i < head.ObjectCount; i++)
+	{
+		memset(&subsets[i], 0, sizeof(MeshMetrics));
+		subsets[i].SubsetID = i;
+		AnalyzeTriangles(view, sorted + start, counts[i] * 3, options, scratch, subsets[i]);
+		start += counts[i] * 3;
+	}
+
+	// The whole mesh in draw order.
+	memset(&total, 0, sizeof(MeshMetrics));
+	total.SubsetID = head.ObjectCount;
+	AnalyzeTriangles(view, view.Indices, triangles * 3, options, scratch, total);
+
+	return true;
+}
@@ -0,0 +1,213 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: ModelParser.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <fstream>
+#include <cstring>
+#include "ModelParser.h"
+using namespace std;
+
+
+bool LoadModel(const char* filename, Arena& arena, Mesh& mesh, ConversionStats* stats, const CoordinateSystem* target)
+{
+	size_t size;
+	string ext = GetExtension(string(filename));
+
+	if (ext != "m3d" && ext != "obj")
+	{
+		return false;
+	}
+
+	StageTimer open(stats, STAGE_OPEN, arena);
+	char* data = ReadWholeFile(filename, arena, size);
+	if (!data)
+	{
+		return false;
+	}
+	open.Stop(size);
+
+	if (ext == "m3d")
+	{
+		return ParseM3D(data, size, arena, mesh, stats, target);
+	}
+
+	return ParseOBJ(data, size, GetDirectory(string(filename)), arena, mesh, stats, target);
+}
+
+
+char* ReadWholeFile(const char* filename, Arena& arena, size_t& size)
+{
+	ifstream fin;
+
+	// Open the file at its end to get the size.
+	fin.open(filename, ios_base::binary | ios_base::ate);
+	if (fin.fail() == true)
+	{
+		return 0;
+	}
+
+	streamoff length = fin.tellg();
+	if (length < 0)
+	{
+		return 0;
+	}
+	fin.seekg(0, ios_base::beg);
+
+	size = (size_t)length;
+	char* data = (char*)arena.Alloc(size + 1);
+	if (!data || !fin.read(data, size))
+	{
+		return 0;
+	}
+
+	// Terminate the text so parsers can always look one character ahead.
+	data[size] = '\0';
+
+	fin.close();
+
+	return data;
+}
+
+
+const char* CopyString(Arena& arena, const string& str)
+{
+	char* copy = (char*)arena.Alloc(str.size() + 1, 1);
+	if (!copy)
+	{
+		return 0;
+	}
+
+	memcpy(copy, str.c_str(), str.size() + 1);
+
+	return copy;
+}
+
+
+std::string removeExtension(const std::string& filename) {
+	size_t lastdot = filename.find_last_of(".");
+	if (lastdot == std::string::npos) return filename;
+	return filename.substr(0, lastdot);
+}
+std::string GetExtension(const std::string& filename)
+{
+	std::string::size_type idx;
+
+	idx = filename.rfind('.');
+
+	if (idx != std::string::npos)
+	{
+		return filename.substr(idx + 1);
+	}
+	else
+	{
+		// No extension found
+		return "";
+	}
+}
+std::string GetDirectory(const std::string& filename)
+{
+	size_t lastslash = filename.find_last_of("/\\");
+	if (lastslash == std::string::npos) return "";
+	return filename.substr(0, lastslash + 1);
+}
+
+
+// Spells a path one way, so two names of the same file compare equal: forward
+// slashes, no empty or "." parts, and ".." taking out the part before it.
+std::string NormalizePath(const std::string& path)
+{
+	std::vector<std::string> parts;
+	bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+
+	std::string::size_type start = 0;
+	while (start <= path.size())
+	{
+		std::string::size_type end = path.find_first_of("/\\", start);
+		if (end == std::string::npos)
+		{
+			end = path.size();
+		}
+
+		std::string part = path.substr(start, end - start);
+		if (part == "..")
+		{
+			if (!parts.empty() && parts.back() != "..")
+			{
+				parts.pop_back();
+			}
+			else if (!absolute)
+			{
+				parts.push_back(part);
+			}
+		}
+		else if (!part.empty() && part != ".")
+		{
+			parts.push_back(part);
+		}
+		start = end + 1;
+	}
+
+	std::string normal = absolute ? "/" : "";
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		normal += (i ? "/" : "") + parts[i];
+	}
+	return normal;
+}
+
+
+UINT TriangleSubset(const Mesh& mesh, ULONG triangle)
+{
+	return mesh.Vertices[mesh.Indices[triangle * 3]].ID;
+}
+
+
+bool GroupTrianglesBySubset(const Mesh& mesh, Arena& arena, SubsetTriangles& groups)
+{
+	UINT objects = mesh.ObjectCount;
+	ULONG triangleCount = mesh.IndexCount / 3;
+
+	// A counting sort on the subset, with the triangles of none last.
+	groups.Order = arena.NewArray<ULONG>(triangleCount);
+	groups.Start = arena.NewArray<ULONG>(objects + 2);
+	if (!groups.Order || !groups.Start)
+	{
+		return false;
+	}
+
+	for (UINT i = 0; i < objects + 2; i++)
+	{
+		groups.Start[i] = 0;
+	}
+	for (ULONG t = 0; t < triangleCount; t++)
+	{
+		const ULONG* index = mesh.Indices + t * 3;
+		if (index[0] >= mesh.VertexCount || index[1] >= mesh.VertexCount || index[2] >= mesh.VertexCount)
+		{
+			return false;
+		}
+
+		UINT id = TriangleSubset(mesh, t);
+		groups.Start[(id < objects ? id : objects) + 1]++;
+	}
+	for (UINT i = 0; i <= objects; i++)
+	{
+		groups.Start[i + 1] += groups.Start[i];
+	}
+	for (ULONG t = 0; t < triangleCount; t++)
+	{
+		UINT id = TriangleSubset(mesh, t);
+		groups.Order[groups.Start[id < objects ? id : objects]++] = t;
+	}
+	for (UINT i = objects + 1; i > 0; i--)
+	{
+		groups.Start[i] = groups.Start[i - 1];
+	}
+	groups.Start[0] = 0;
+
+	return true;
+}
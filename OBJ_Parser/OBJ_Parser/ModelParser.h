@@ -0,0 +1,494 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: ModelParser.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MODELPARSER_H_
+#define _MODELPARSER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstdint>
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <map>
+#include <vector>
+#include "XMCompat.h"
+#include "Arena.h"
+#include "Stats.h"
+
+
+//////////////
+// TYPEDEFS //
+//////////////
+typedef unsigned int UINT;
+
+// 32 bits on every platform so .smf files match the layout written on Windows.
+typedef std::uint32_t ULONG;
+
+struct SubsetTableDesc
+{
+	UINT SubsetID;
+	ULONG VertexStart;
+	ULONG VertexCount;
+	ULONG FaceStart;
+	ULONG FaceCount;
+};
+
+struct MatrialDesc
+{
+	DirectX::XMFLOAT3 Ambient;
+	DirectX::XMFLOAT3 Diffuse;
+	DirectX::XMFLOAT3 Specular;
+	float SpecPower;
+	DirectX::XMFLOAT3 Reflectivity;
+	float AlphaClip;
+};
+
+struct MtlDesc
+{
+	MatrialDesc Material;
+	std::string DiffuseMap;
+	std::string NormalMap;
+};
+
+typedef std::map<std::string, MtlDesc> MtlLibrary;
+
+typedef struct
+{
+	float x, y, z;
+}VertexType;
+
+// Indices count from 1 as in the file. A texture coordinate or normal index
+// of 0 is one the face leaves out. Smoothing is the face's s group, 0 if off.
+typedef struct
+{
+	int vIndex1, vIndex2, vIndex3, vIndex4;
+	int tIndex1, tIndex2, tIndex3, tIndex4;
+	int nIndex1, nIndex2, nIndex3, nIndex4;
+	int Count;
+	unsigned int ID;
+	unsigned int Smoothing;
+}FaceType;
+
+struct Header
+{
+	ULONG VertexCount;
+	ULONG IndexCount;
+	ULONG bfOffBits;
+	UINT ObjectCount;
+};
+
+// Files written with extensions carry an SMFExtension and its section table
+// right after the Header. bfOffBits still points at the materials, so readers
+// that only know the Header skip the table, but sections stored with an
+// encoding other than SMF_ENCODING_RAW need a reader that knows the table.
+struct SMFExtension
+{
+	char Magic[4];
+	UINT Version;
+	UINT SectionCount;
+	UINT Reserved;
+};
+
+struct SMFSection
+{
+	UINT Type;
+	UINT Encoding;
+	unsigned long long Offset;
+	unsigned long long Size;
+};
+
+enum SMFSectionType
+{
+	SMF_SECTION_VERTICES = 1,
+	SMF_SECTION_INDICES = 2,
+	SMF_SECTION_TEXTURES = 3,
+	SMF_SECTION_INSTANCES = 4,
+	SMF_SECTION_SKIN = 5,
+	SMF_SECTION_PALETTES = 6,
+	SMF_SECTION_COLLISION = 7
+};
+
+enum SMFEncoding
+{
+	SMF_ENCODING_RAW = 0,
+	SMF_ENCODING_PACKED = 1
+};
+
+enum SMFWriteFlags
+{
+	SMF_WRITE_COMPRESS = 1,
+	SMF_WRITE_SKIN = 2
+};
+
+struct vertexData
+{
+	DirectX::XMFLOAT3 pos;
+	DirectX::XMFLOAT2 tex;
+	DirectX::XMFLOAT3 Normal;
+	unsigned int ID;
+};
+
+// Another placement of a subset's geometry. The instance is drawn with the
+// vertices and triangles of SubsetID, transformed by Transform, and with the
+// material and texture of ObjectID, the object it replaced.
+struct InstanceDesc
+{
+	UINT SubsetID;
+	UINT ObjectID;
+	DirectX::XMFLOAT4X3 Transform;
+};
+
+// Skinning data of a vertex, parallel to the vertex array. BlendIndices name
+// skeleton bones until SplitBonePalettes() turns them into indices into the
+// palette of the vertex's subset.
+struct SkinVertex
+{
+	DirectX::XMFLOAT4 BlendWeights;
+	unsigned char BlendIndices[4];
+};
+
+// The bones a subset draws with: Count entries of the palette bone list from
+// Start on, each a skeleton bone.
+struct BonePaletteDesc
+{
+	UINT Start;
+	UINT Count;
+};
+
+// A convex collision proxy for a subset, as a range of hull vertices and of
+// triangle indices into that range. A subset decomposed into several convex
+// pieces has one HullDesc per piece.
+struct HullDesc
+{
+	UINT SubsetID;
+	UINT VertexStart;
+	UINT VertexCount;
+	UINT IndexStart;
+	UINT IndexCount;
+};
+
+// Leads the collision section, followed by the HullDescs, the hull vertices
+// as XMFLOAT3 and the hull indices as UINT.
+struct CollisionHeader
+{
+	UINT HullCount;
+	UINT VertexCount;
+	UINT IndexCount;
+	UINT Reserved;
+};
+
+// A converted model. Every array lives in the arena it was parsed into and is
+// valid until that arena is reset.
+struct Mesh
+{
+	UINT VertexCount;
+	UINT IndexCount;
+	UINT ObjectCount;
+	vertexData* Vertices;
+	ULONG* Indices;
+	MatrialDesc* Materials;
+	SubsetTableDesc* Subsets;
+	UINT* TextureSize;
+	const char** TextureName;
+	InstanceDesc* Instances;
+	UINT InstanceCount;
+	SkinVertex* Skin;
+	UINT BoneCount;
+	BonePaletteDesc* Palettes;
+	UINT* PaletteBones;
+	UINT PaletteBoneCount;
+	HullDesc* Hulls;
+	UINT HullCount;
+	DirectX::XMFLOAT3* HullVertices;
+	UINT HullVertexCount;
+	UINT* HullIndices;
+	UINT HullIndexCount;
+};
+
+// A .smf file mapped over a buffer. Pointers refer into that buffer, except
+// TextureName and packed sections, which are decoded into the arena given to
+// ReadSMF. Sections is 0 for files without extensions, Instances for files
+// without an instance table, Skin and Palettes for files without skinning and
+// Hulls for files without collision proxies.
+struct SMFView
+{
+	const Header* Head;
+	const SMFSection* Sections;
+	UINT SectionCount;
+	const MatrialDesc* Materials;
+	const vertexData* Vertices;
+	const ULONG* Indices;
+	const UINT* TextureSize;
+	const char** TextureName;
+	const InstanceDesc* Instances;
+	UINT InstanceCount;
+	const SkinVertex* Skin;
+	const BonePaletteDesc* Palettes;
+	const UINT* PaletteBones;
+	UINT PaletteBoneCount;
+	const HullDesc* Hulls;
+	UINT HullCount;
+	const DirectX::XMFLOAT3* HullVertices;
+	UINT HullVertexCount;
+	const UINT* HullIndices;
+	UINT HullIndexCount;
+};
+
+// Where the sections of a .smf file lie, worked out from the header and the
+// extension table. Only the first bfOffBits bytes have to be present for it.
+struct SMFLayout
+{
+	unsigned long long MaterialOffset;
+	unsigned long long VertexOffset;
+	unsigned long long VertexBytes;
+	UINT VertexEncoding;
+	unsigned long long IndexOffset;
+	unsigned long long IndexBytes;
+	UINT IndexEncoding;
+	unsigned long long TextureOffset;
+	unsigned long long TextureEnd;
+	unsigned long long InstanceOffset;
+	UINT InstanceCount;
+	unsigned long long SkinOffset;
+	unsigned long long PaletteOffset;
+	unsigned long long PaletteBytes;
+	unsigned long long CollisionOffset;
+	unsigned long long CollisionBytes;
+	unsigned long long SectionEnd;
+};
+
+// A packed section decoded chunk by chunk as it arrives. Next is the first
+// chunk not yet decoded and Done counts the vertices or indices before it.
+// Planes and Delta are the scratch the chunks decode through.
+struct SectionUnpacker
+{
+	const unsigned char* Next;
+	ULONG Done;
+	unsigned char* Planes;
+	std::uint32_t* Delta;
+};
+
+// A coordinate convention. Every parser describes its input with one and
+// converts to the one it is given. UnitScale is the length of one unit in
+// meters, so going from 1 to 0.01 scales positions by 100.
+struct CoordinateSystem
+{
+	UINT Handedness;
+	UINT UpAxis;
+	UINT Winding;
+	UINT UVOrigin;
+	float UnitScale;
+};
+
+enum CoordinateHandedness
+{
+	HANDED_LEFT = 0,
+	HANDED_RIGHT = 1
+};
+
+enum CoordinateUpAxis
+{
+	UP_AXIS_Y = 0,
+	UP_AXIS_Z = 1
+};
+
+// The order front faces are listed in, seen from the front.
+enum CoordinateWinding
+{
+	WINDING_CW = 0,
+	WINDING_CCW = 1
+};
+
+enum CoordinateUVOrigin
+{
+	UV_ORIGIN_TOP_LEFT = 0,
+	UV_ORIGIN_BOTTOM_LEFT = 1
+};
+
+// How far apart two subsets may be, after moving one onto the other, and still
+// count as the same geometry. PositionTolerance is a fraction of the subset's
+// radius, so it holds for props of any size. Texture coordinates have to match
+// exactly.
+struct InstanceOptions
+{
+	float PositionTolerance;
+	float NormalTolerance;
+};
+
+// Collision hulls keep at most MaxHullVertices vertices each. A subset is cut
+// into up to MaxHulls convex pieces, as long as a cut shrinks the hull volume
+// of the piece it cuts by at least MinSplitGain.
+struct CollisionOptions
+{
+	UINT MaxHullVertices;
+	UINT MaxHulls;
+	float MinSplitGain;
+};
+
+struct AnalysisOptions
+{
+	UINT FifoCacheSize;
+	UINT LruCacheSize;
+	UINT FetchCacheBytes;
+	UINT FetchLineBytes;
+	UINT OverdrawResolution;
+};
+
+// Vertex processing efficiency of a subset, or of the whole mesh.
+struct MeshMetrics
+{
+	UINT SubsetID;
+	ULONG Triangles;
+	ULONG Vertices;
+	float AcmrFifo;
+	float AtvrFifo;
+	float AcmrLru;
+	float AtvrLru;
+	float Overdraw;
+	float Overfetch;
+	float FetchEfficiency;
+};
+
+// What InspectSMF prints besides the header and subset summary.
+struct InspectOptions
+{
+	std::vector<UINT> Subsets;
+	bool DumpVertices;
+	ULONG VertexBegin, VertexEnd;
+	bool DumpIndices;
+	ULONG IndexBegin, IndexEnd;
+};
+
+// The attribute arrays of an OBJ file between the parse and face expansion stages.
+struct ObjData
+{
+	int vertexCount, textureCount, normalCount, faceCount, objectCount;
+	VertexType* vertices;
+	VertexType* texcoords;
+	VertexType* normals;
+	// Triangles and quads; faces with more corners are fanned into triangles.
+	FaceType* faces;
+	std::string* textureArray;
+	MtlLibrary materials;
+	// Faces with a corner that names no normal, and the normals made for
+	// them by GenerateNormals(), four per face.
+	int missingNormals;
+	VertexType* generatedNormals;
+	// Faces left out for naming an element the file does not have, and the
+	// triangles they would have made.
+	int badFaces;
+	int badTriangles;
+};
+
+// The triangles of a mesh grouped by subset, each group in mesh order. Subset
+// s owns Order[Start[s]] up to Order[Start[s + 1]]; triangles of no subset
+// come after Start[ObjectCount].
+struct SubsetTriangles
+{
+	ULONG* Order;
+	ULONG* Start;
+};
+
+
+/////////////////////////
+// FUNCTION PROTOTYPES //
+/////////////////////////
+
+// In-memory conversion.
+// Passing stats records the time, bytes and allocations of every stage.
+// Without a target the mesh comes out in DefaultCoordinateSystem().
+bool ParseOBJ(const char* data, size_t size, const std::string& directory, Arena& arena, Mesh& mesh, ConversionStats* stats = 0, const CoordinateSystem* target = 0);
+bool ParseM3D(const char* data, size_t size, Arena& arena, Mesh& mesh, ConversionStats* stats = 0, const CoordinateSystem* target = 0);
+bool LoadModel(const char* filename, Arena& arena, Mesh& mesh, ConversionStats* stats = 0, const CoordinateSystem* target = 0);
+
+// Coordinate conversion.
+void DefaultCoordinateSystem(CoordinateSystem& system);
+void ObjCoordinateSystem(CoordinateSystem& system);
+void M3DCoordinateSystem(CoordinateSystem& system);
+void ConvertCoordinates(Mesh& mesh, const CoordinateSystem& from, const CoordinateSystem& to);
+
+// Validation. Drops the triangles that name a vertex the mesh does not have,
+// touch a NaN or infinite attribute or have no area, and counts them.
+bool SanitizeMesh(Mesh& mesh, Arena& arena, ValidationStats* validation = 0);
+
+// Subset membership. A triangle belongs to the subset of its first vertex,
+// which may be none. Grouping fails on an index past the vertices.
+UINT TriangleSubset(const Mesh& mesh, ULONG triangle);
+bool GroupTrianglesBySubset(const Mesh& mesh, Arena& arena, SubsetTriangles& groups);
+
+// Instancing.
+void DefaultInstanceOptions(InstanceOptions& options);
+bool FindInstances(Mesh& mesh, const InstanceOptions& options, Arena& arena);
+
+// Skinning.
+bool SplitBonePalettes(Mesh& mesh, UINT paletteSize, Arena& arena);
+
+// Collision proxies. system is the space the mesh is in, so the hull
+// triangles face out the way its front faces do.
+void DefaultCollisionOptions(CollisionOptions& options);
+bool BuildCollisionHulls(Mesh& mesh, const CollisionOptions& options, const CoordinateSystem& system, Arena& arena);
+
+// .smf output and loading.
+// SMFSize() is the size WriteSMF() writes with these flags, with packed
+// sections at their unpacked size.
+unsigned long long SMFSize(const Mesh& mesh, UINT flags = 0);
+// Packing needs scratch memory; without an arena a temporary one is used.
+// written, if given, receives the bytes actually written.
+bool WriteSMF(const Mesh& mesh, std::ostream& bout, UINT flags = 0, Arena* scratch = 0, unsigned long long* written = 0);
+bool WriteSMF(const Mesh& mesh, const char* filename, UINT flags = 0, Arena* scratch = 0, unsigned long long* written = 0);
+bool ReadSMF(const char* data, size_t size, Arena& arena, SMFView& view);
+bool ReadSMFLayout(const char* data, size_t size, SMFView& view, SMFLayout& layout);
+bool ReadSMFTextures(const char* data, const SMFLayout& layout, Arena& arena, SMFView& view);
+bool ReadSMFInstances(const char* data, const SMFLayout& layout, SMFView& view);
+bool ReadSMFSkin(const char* data, const SMFLayout& layout, SMFView& view);
+bool ReadSMFCollision(const char* data, const SMFLayout& layout, SMFView& view);
+bool LoadSMF(const char* filename, Arena& arena, SMFView& view);
+
+// Section codecs used for SMF_ENCODING_PACKED.
+bool PackVertices(const vertexData* vertices, ULONG count, Arena& arena, const unsigned char*& packed, size_t& size);
+bool UnpackVertices(const unsigned char* packed, size_t size, vertexData* vertices, ULONG count, Arena& arena);
+bool PackIndices(const ULONG* indices, ULONG count, Arena& arena, const unsigned char*& packed, size_t& size);
+bool UnpackIndices(const unsigned char* packed, size_t size, ULONG* indices, ULONG count, Arena& arena);
+// The chunk functions decode the next chunk if it lies wholly before end and
+// leave the unpacker as it is otherwise. They fail on a chunk that does not
+// decode; a section that ends short is for the caller to notice.
+bool BeginUnpackVertices(SectionUnpacker& unpacker, const unsigned char* packed, Arena& arena);
+bool UnpackVertexChunk(SectionUnpacker& unpacker, const unsigned char* end, vertexData* vertices, ULONG count);
+bool BeginUnpackIndices(SectionUnpacker& unpacker, const unsigned char* packed, Arena& arena);
+bool UnpackIndexChunk(SectionUnpacker& unpacker, const unsigned char* end, ULONG* indices, ULONG count);
+
+// .smf inspection.
+class TextWriter;
+void DefaultInspectOptions(InspectOptions& options);
+bool ParseRange(const char* text, ULONG& begin, ULONG& end);
+bool InspectSMF(const SMFView& view, const InspectOptions& options, Arena& arena, TextWriter& out);
+
+// Mesh quality analysis.
+void DefaultAnalysisOptions(AnalysisOptions& options);
+bool AnalyzeMesh(const SMFView& view, const AnalysisOptions& options, Arena& arena, MeshMetrics** ppSubsets, MeshMetrics& total);
+
+// Conversion stages, exposed for tools that drive them one at a time.
+bool ReadFileCounts(std::istream& fin, int& vertexCount, int& textureCount, int& normalCount, int& faceCount, int& objectCount);
+bool LoadDataStructures(std::istream& fin, const std::string& directory, Arena& arena, ObjData& obj);
+bool GenerateNormals(ObjData& obj, Arena& arena);
+bool ExpandFaces(const ObjData& obj, Arena& arena, Mesh& mesh);
+bool M3DReadFileCounts(std::istream& fin, Arena& arena, Mesh& mesh, ConversionStats* stats = 0);
+
+// Materials.
+const MtlLibrary* LoadMaterialLibrary(const std::string& filename);
+void ClearMaterialCache();
+void TakeMaterialLibrariesUsed(std::vector<std::string>& libraries);
+void DefaultMaterial(MatrialDesc* m);
+
+// Helpers.
+char* ReadWholeFile(const char* filename, Arena& arena, size_t& size);
+const char* CopyString(Arena& arena, const std::string& str);
+std::string removeExtension(const std::string& filename);
+std::string GetExtension(const std::string& filename);
+std::string GetDirectory(const std::string& filename);
+std::string NormalizePath(const std::string& path);
+
+#endif
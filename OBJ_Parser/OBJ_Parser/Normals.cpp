@@ -0,0 +1,221 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Normals.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <cmath>
+#include "ModelParser.h"
+#include "Parallel.h"
+using namespace std;
+
+
+// Faces or positions per thread below which threads cost more than they save.
+static const size_t NORMAL_GRAIN = 16 * 1024;
+
+
+static VertexType Sub(const VertexType& a, const VertexType& b)
+{
+	VertexType r = { a.x - b.x, a.y - b.y, a.z - b.z };
+	return r;
+}
+
+
+static VertexType Cross(const VertexType& a, const VertexType& b)
+{
+	VertexType r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	return r;
+}
+
+
+static float Length(const VertexType& a)
+{
+	return sqrtf(a.x * a.x + a.y * a.y + a.z * a.z);
+}
+
+
+static VertexType Normalized(const VertexType& a)
+{
+	// Degenerate faces get no direction rather than a NaN.
+	float length = Length(a);
+	VertexType r = { 0.0f, 0.0f, 0.0f };
+	if (length > 0.0f)
+	{
+		r.x = a.x / length;
+		r.y = a.y / length;
+		r.z = a.z / length;
+	}
+	return r;
+}
+
+
+// Every corner's share of its vertex normal: the face normal scaled by the
+// face's area and by the angle the face spans at that corner, so neither a
+// fan of slivers nor one huge neighbour pulls the normal over.
+static void CornerWeights(const ObjData& obj, size_t begin, size_t end, VertexType* weights, VertexType* flat)
+{
+	for (size_t f = begin; f < end; f++)
+	{
+		const FaceType& face = obj.faces[f];
+		const int* index = &face.vIndex1;
+		int count = face.Count;
+
+		VertexType p[4];
+		for (int k = 0; k < count; k++)
+		{
+			p[k] = obj.vertices[index[k] - 1];
+		}
+
+		// The cross product of the diagonals is twice a quad's area, as the
+		// cross product of two edges is for a triangle.
+		VertexType normal = count == 4 ? Cross(Sub(p[2], p[0]), Sub(p[3], p[1])) : Cross(Sub(p[1], p[0]), Sub(p[2], p[0]));
+		flat[f] = Normalized(normal);
+
+		for (int k = 0; k < count; k++)
+		{
+			VertexType a = Normalized(Sub(p[(k + 1) % count], p[k]));
+			VertexType b = Normalized(Sub(p[(k + count - 1) % count], p[k]));
+			float cosine = a.x * b.x + a.y * b.y + a.z * b.z;
+			float angle = acosf(cosine < -1.0f ? -1.0f : cosine > 1.0f ? 1.0f : cosine);
+
+			// A NaN or infinite position must not spread to its neighbours'
+			// normals; validation drops the faces it is on.
+			VertexType& w = weights[f * 4 + k];
+			w.x = normal.x * angle;
+			w.y = normal.y * angle;
+			w.z = normal.z * angle;
+			if (!isfinite(w.x) || !isfinite(w.y) || !isfinite(w.z))
+			{
+				w.x = w.y = w.z = 0.0f;
+			}
+		}
+	}
+}
+
+
+bool GenerateNormals(ObjData& obj, Arena& arena)
+{
+	obj.generatedNormals = 0;
+	if (obj.missingNormals == 0)
+	{
+		return true;
+	}
+
+	size_t faceCount = obj.faceCount;
+	size_t vertexCount = obj.vertexCount;
+
+	// A corner naming a position the file does not have cannot get a normal.
+	for (size_t f = 0; f < faceCount; f++)
+	{
+		const int* index = &obj.faces[f].vIndex1;
+		for (int k = 0; k < obj.faces[f].Count; k++)
+		{
+			if (index[k] < 1 || (size_t)index[k] > vertexCount)
+			{
+				return false;
+			}
+		}
+	}
+
+	VertexType* weights = arena.NewArray<VertexType>(faceCount * 4);
+	VertexType* flat = arena.NewArray<VertexType>(faceCount);
+	VertexType* normals = arena.NewArray<VertexType>(faceCount * 4);
+	ULONG* start = arena.NewArray<ULONG>(vertexCount + 1);
+	ULONG* corners = arena.NewArray<ULONG>(faceCount * 4);
+	if (!weights || !flat || !normals || !start || !corners)
+	{
+		return false;
+	}
+
+	ParallelFor(faceCount, NORMAL_GRAIN, [&](size_t begin, size_t end) {
+		CornerWeights(obj, begin, end, weights, flat);
+	});
+
+	// List the corners at every position.
+	for (size_t i = 0; i <= vertexCount; i++)
+	{
+		start[i] = 0;
+	}
+	for (size_t f = 0; f < faceCount; f++)
+	{
+		const int* index = &obj.faces[f].vIndex1;
+		for (int k = 0; k < obj.faces[f].Count; k++)
+		{
+			start[index[k]]++;
+		}
+	}
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		start[i + 1] += start[i];
+	}
+	for (size_t f = 0; f < faceCount; f++)
+	{
+		const int* index = &obj.faces[f].vIndex1;
+		for (int k = 0; k < obj.faces[f].Count; k++)
+		{
+			corners[start[index[k] - 1]++] = (ULONG)(f * 4 + k);
+		}
+	}
+	for (size_t i = vertexCount; i > 0; i--)
+	{
+		start[i] = start[i - 1];
+	}
+	start[0] = 0;
+
+	// Each position sums the corners of every smoothing group apart. Corners
+	// outside any group keep the normal of their face. Positions own their
+	// corners, so the threads never write the same normal.
+	const FaceType* faces = obj.faces;
+	ParallelFor(vertexCount, NORMAL_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++)
+		{
+			ULONG* first = corners + start[v];
+			ULONG* last = corners + start[v + 1];
+			sort(first, last, [&](ULONG a, ULONG b) {
+				return faces[a / 4].Smoothing < faces[b / 4].Smoothing;
+			});
+
+			for (ULONG* run = first; run != last; )
+			{
+				unsigned int group = faces[*run / 4].Smoothing;
+				ULONG* runEnd = run + 1;
+				while (runEnd != last && faces[*runEnd / 4].Smoothing == group)
+				{
+					runEnd++;
+				}
+
+				if (group == 0)
+				{
+					for (ULONG* c = run; c != runEnd; c++)
+					{
+						normals[*c] = flat[*c / 4];
+					}
+				}
+				else
+				{
+					VertexType sum = { 0.0f, 0.0f, 0.0f };
+					for (ULONG* c = run; c != runEnd; c++)
+					{
+						sum.x += weights[*c].x;
+						sum.y += weights[*c].y;
+						sum.z += weights[*c].z;
+					}
+					sum = Normalized(sum);
+					for (ULONG* c = run; c != runEnd; c++)
+					{
+						normals[*c] = sum;
+					}
+				}
+
+				run = runEnd;
+			}
+		}
+	});
+
+	obj.generatedNormals = normals;
+
+	return true;
+}
@@ -0,0 +1,665 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: OBJParser.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include "ModelParser.h"
+#include "MemoryStream.h"
+using namespace DirectX;
+using namespace std;
+
+
+void fToXM(XMFLOAT3* xm, VertexType v)
+{
+	xm->x = v.x;
+	xm->y = v.y;
+	xm->z = v.z;
+}
+void fToXM(XMFLOAT2* xm, VertexType v)
+{
+	xm->x = v.x;
+	xm->y = v.y;
+}
+
+// Reads a float, letting nan, inf and values out of range through as NaN and
+// infinities for validation to find rather than failing the stream.
+static void ReadFloat(istream& fin, float& value)
+{
+	fin >> value;
+	if (!fin.fail())
+	{
+		return;
+	}
+
+	// Out of range values are read whole and come back as the largest float.
+	fin.clear();
+	if (value == FLT_MAX || value == -FLT_MAX)
+	{
+		value = value > 0.0f ? HUGE_VALF : -HUGE_VALF;
+		return;
+	}
+
+	string token;
+	fin >> token;
+	value = strtof(token.c_str(), 0);
+}
+
+
+// Reads one corner of a face: v, v/t, v//n or v/t/n. Indices left out become
+// 0 and negative ones count back from the last element read so far.
+static void ReadFaceCorner(istream& fin, int vertexCount, int texcoordCount, int normalCount, int& v, int& t, int& n)
+{
+	v = t = n = 0;
+	fin >> v;
+	if (fin.peek() == '/')
+	{
+		fin.get();
+		if (fin.peek() != '/')
+		{
+			fin >> t;
+		}
+		if (fin.peek() == '/')
+		{
+			fin.get();
+			fin >> n;
+		}
+	}
+
+	if (v < 0) { v += vertexCount + 1; }
+	if (t < 0) { t += texcoordCount + 1; }
+	if (n < 0) { n += normalCount + 1; }
+}
+
+
+// Whether every corner of a face names a position the file has, and a
+// texture coordinate and normal it has or none at all.
+static bool FaceInRange(const FaceType& face, const ObjData& obj)
+{
+	for (int k = 0; k < face.Count; k++)
+	{
+		int v = (&face.vIndex1)[k];
+		int t = (&face.tIndex1)[k];
+		int n = (&face.nIndex1)[k];
+		if (v < 1 || v > obj.vertexCount || t < 0 || t > obj.textureCount || n < 0 || n > obj.normalCount)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+// Whether another corner follows on the face's line.
+static bool MoreCorners(istream& fin)
+{
+	while (fin.peek() == ' ' || fin.peek() == '\t')
+	{
+		fin.get();
+	}
+
+	int c = fin.peek();
+	return c == '-' || (c >= '0' && c <= '9');
+}
+
+
+void insertData(vertexData* data, VertexType p, VertexType t, VertexType n, unsigned int id)
+{
+	fToXM(&data->pos, p);
+	fToXM(&data->tex, t);
+	fToXM(&data->Normal, n);
+	data->ID = id;
+}
+
+
+bool ParseOBJ(const char* data, size_t size, const string& directory, Arena& arena, Mesh& mesh, ConversionStats* stats, const CoordinateSystem* target)
+{
+	ObjData obj;
+	bool result;
+
+	// Read in the number of vertices, tex coords, normals, and faces so that the data structures can be initialized with the exact sizes needed.
+	StageTimer count(stats, STAGE_COUNT, arena);
+	MemoryStream counts(data, size);
+	result = ReadFileCounts(counts, obj.vertexCount, obj.textureCount, obj.normalCount, obj.faceCount, obj.objectCount);
+	if (!result)
+	{
+		return false;
+	}
+	count.Stop(size);
+
+	// Now read the data into the data structures and expand the faces into the mesh.
+	StageTimer parse(stats, STAGE_PARSE, arena);
+	MemoryStream fin(data, size);
+	result = LoadDataStructures(fin, directory, arena, obj);
+	if (!result)
+	{
+		return false;
+	}
+	parse.Stop(size);
+
+	// Faces without normals get smooth ones, split along the smoothing groups.
+	StageTimer normals(stats, STAGE_NORMALS, arena);
+	result = GenerateNormals(obj, arena);
+	if (!result)
+	{
+		return false;
+	}
+	normals.Stop(sizeof(VertexType) * 4 * obj.missingNormals);
+
+	StageTimer expand(stats, STAGE_EXPAND, arena);
+	result = ExpandFaces(obj, arena, mesh);
+	if (!result)
+	{
+		return false;
+	}
+	expand.Stop(sizeof(vertexData) * mesh.VertexCount + sizeof(ULONG) * mesh.IndexCount);
+
+	// Faces the parser left out count with the triangles validation drops.
+	StageTimer validate(stats, STAGE_VALIDATE, arena);
+	if (stats)
+	{
+		stats->Validation.BadIndices += obj.badFaces;
+		stats->Validation.DroppedTriangles += obj.badTriangles;
+	}
+	result = SanitizeMesh(mesh, arena, stats ? &stats->Validation : 0);
+	if (!result)
+	{
+		return false;
+	}
+	validate.Stop(sizeof(vertexData) * mesh.VertexCount + sizeof(ULONG) * mesh.IndexCount);
+
+	// The data is still in the file's right handed space.
+	StageTimer convert(stats, STAGE_CONVERT, arena);
+	CoordinateSystem from, to;
+	ObjCoordinateSystem(from);
+	DefaultCoordinateSystem(to);
+	ConvertCoordinates(mesh, from, target ? *target : to);
+	convert.Stop(sizeof(vertexData) * mesh.VertexCount + sizeof(ULONG) * mesh.IndexCount);
+
+	return true;
+}
+
+
+bool ReadFileCounts(istream& fin, int& vertexCount, int& textureCount, int& normalCount, int& faceCount, int& objectCount)
+{
+	char input;
+
+	// Initialize the counts.
+	vertexCount = 0;
+	textureCount = 0;
+	normalCount = 0;
+	faceCount = 0;
+	objectCount = 0;
+
+	// Read from the file and continue to read until the end of the file is reached.
+	fin.get(input);
+	while (!fin.eof())
+	{
+		// If the line starts with 'v' then count either the vertex, the texture coordinates, or the normal vector.
+		if (input == 'v')
+		{
+			fin.get(input);
+			if (input == ' ') { vertexCount++; }
+			if (input == 't') { textureCount++; }
+			if (input == 'n') { normalCount++; }
+		}
+
+		// If the line starts with 'f' then count the faces it makes. A face of
+		// more than four corners is fanned into one triangle per corner past two.
+		if (input == 'f')
+		{
+			fin.get(input);
+			if (input == ' ')
+			{
+				int corners = 0;
+				bool gap = true;
+				while (input != '\n' && !fin.eof())
+				{
+					fin.get(input);
+					bool space = input == ' ' || input == '\t' || input == '\r' || input == '\n';
+					if (gap && !space)
+					{
+						corners++;
+					}
+					gap = space;
+				}
+				faceCount += corners > 4 ? corners - 2 : 1;
+			}
+		}
+
+		if (input == 'o' || input == 'g')
+		{
+			fin.get(input);
+			if (input == ' ')
+			{
+				objectCount++;
+			}
+		}
+
+		// Otherwise read in the remainder of the line.
+		// A token that is no number fails the stream; the rest of its line is
+		// dropped like any other.
+		if (fin.fail() && !fin.eof())
+		{
+			fin.clear();
+		}
+
+		while (input != '\n' && !fin.eof())
+		{
+			fin.get(input);
+		}
+
+		// Start reading the beginning of the next line.
+		fin.get(input);
+	}
+
+	return true;
+}
+
+
+bool LoadDataStructures(istream& fin, const string& directory, Arena& arena, ObjData& obj)
+{
+	VertexType *vertices, *texcoords, *normals;
+	FaceType *faces;
+	int vertexIndex, texcoordIndex, normalIndex, faceIndex, objectIndex;
+	unsigned int smoothing;
+	char input;
+	vector<int> cornerV, cornerT, cornerN;
+	int faceSlots = obj.faceCount;
+
+
+	// Initialize the four data structures.
+	vertices = obj.vertices = arena.NewArray<VertexType>(obj.vertexCount);
+	if (!vertices)
+	{
+		return false;
+	}
+
+	texcoords = obj.texcoords = arena.NewArray<VertexType>(obj.textureCount);
+	if (!texcoords)
+	{
+		return false;
+	}
+
+	normals = obj.normals = arena.NewArray<VertexType>(obj.normalCount);
+	if (!normals)
+	{
+		return false;
+	}
+
+	faces = obj.faces = arena.NewArray<FaceType>(obj.faceCount);
+	if (!faces)
+	{
+		return false;
+	}
+
+	string* textureArray = obj.textureArray = arena.NewArray<string>(obj.objectCount);
+	if (!textureArray)
+	{
+		return false;
+	}
+
+	// Initialize the indexes.
+	vertexIndex = 0;
+	texcoordIndex = 0;
+	normalIndex = 0;
+	faceIndex = 0;
+	objectIndex = -1;
+	smoothing = 0;
+	obj.missingNormals = 0;
+	obj.generatedNormals = 0;
+	obj.badFaces = 0;
+	obj.badTriangles = 0;
+
+	// Read in the vertices, texture coordinates, and normals into the data structures.
+	// They stay in the file's coordinate system until ConvertCoordinates().
+	fin.get(input);
+	while (!fin.eof())
+	{
+		if (input == 'v')
+		{
+			fin.get(input);
+
+			// Read in the vertices.
+			if (input == ' ')
+			{
+				ReadFloat(fin, vertices[vertexIndex].x);
+				ReadFloat(fin, vertices[vertexIndex].y);
+				ReadFloat(fin, vertices[vertexIndex].z);
+				vertexIndex++;
+			}
+
+			// Read in the texture uv coordinates.
+			if (input == 't')
+			{
+				ReadFloat(fin, texcoords[texcoordIndex].x);
+				ReadFloat(fin, texcoords[texcoordIndex].y);
+				texcoordIndex++;
+			}
+
+			// Read in the normals.
+			if (input == 'n')
+			{
+				ReadFloat(fin, normals[normalIndex].x);
+				ReadFloat(fin, normals[normalIndex].y);
+				ReadFloat(fin, normals[normalIndex].z);
+				normalIndex++;
+			}
+		}
+
+		// Read in the faces.
+		if (input == 'f')
+		{
+			fin.get(input);
+			if (input == ' ')
+			{
+				// Corners are only read while the line has one, so a short
+				// face never reads into the next line.
+				cornerV.clear();
+				cornerT.clear();
+				cornerN.clear();
+				while (MoreCorners(fin))
+				{
+					int v, t, n;
+					ReadFaceCorner(fin, vertexIndex, texcoordIndex, normalIndex, v, t, n);
+					cornerV.push_back(v);
+					cornerT.push_back(t);
+					cornerN.push_back(n);
+				}
+				int corners = (int)cornerV.size();
+
+				// A token that is no index fails the stream; clearing it lets
+				// the rest of the line be skipped and the face count as bad.
+				bool unreadable = fin.fail();
+				if (unreadable && !fin.eof())
+				{
+					fin.clear();
+				}
+
+				// Triangles and quads are kept whole; larger faces are fanned
+				// from their first corner, one triangle per corner past two.
+				int pieces = corners > 4 ? corners - 2 : 1;
+				bool bad = unreadable || corners < 3 || faceIndex + pieces > faceSlots;
+				for (int p = 0; p < pieces && !bad; p++)
+				{
+					FaceType& face = faces[faceIndex + p];
+					face.Count = corners > 4 ? 3 : corners;
+					int* vIndices = &face.vIndex1;
+					int* tIndices = &face.tIndex1;
+					int* nIndices = &face.nIndex1;
+					for (int k = 0; k < 4; k++)
+					{
+						int c = corners > 4 && k ? p + k : k;
+						bool used = k < face.Count;
+						vIndices[k] = used ? cornerV[c] : 0;
+						tIndices[k] = used ? cornerT[c] : 0;
+						nIndices[k] = used ? cornerN[c] : 0;
+					}
+					face.ID = objectIndex;
+					face.Smoothing = smoothing;
+
+					// A face naming an element the file does not have is
+					// left out rather than read past the arrays later.
+					bad = !FaceInRange(face, obj);
+				}
+
+				if (bad)
+				{
+					obj.badFaces++;
+					obj.badTriangles += corners > 2 ? corners - 2 : 0;
+				}
+				else
+				{
+					for (int p = 0; p < pieces; p++)
+					{
+						const FaceType& face = faces[faceIndex + p];
+						if (face.nIndex1 == 0 || face.nIndex2 == 0 || face.nIndex3 == 0 || (face.Count == 4 && face.nIndex4 == 0))
+						{
+							obj.missingNormals++;
+						}
+					}
+					faceIndex += pieces;
+				}
+
+				// The rest of the line, if any, is skipped below.
+				input = ' ';
+			}
+		}
+
+		if (input == 'o' || input == 'g')
+		{
+			fin.get(input);
+			if (input == ' ')
+			{
+				objectIndex++;
+			}
+		}
+
+		// Smoothing groups, named by number. Both 0 and off end the group.
+		if (input == 's')
+		{
+			fin.get(input);
+			if (input == ' ')
+			{
+				string line, group;
+				getline(fin, line);
+				istringstream ls(line);
+				ls >> group;
+				smoothing = group == "off" ? 0 : (unsigned int)atoi(group.c_str());
+				input = '\n';
+			}
+		}
+
+		// Load the material libraries referenced by the file.
+		if (input == 'm')
+		{
+			string keyword;
+			fin >> keyword;
+			if (keyword == "tllib")
+			{
+				string libraries, library;
+				getline(fin, libraries);
+				istringstream ls(libraries);
+				while (ls >> library)
+				{
+					const MtlLibrary* lib = LoadMaterialLibrary(directory + library);
+					if (lib)
+					{
+						obj.materials.insert(lib->begin(), lib->end());
+					}
+				}
+				input = '\n';
+			}
+		}
+
+		if (input == 'u')
+		{
+			fin.get(input);
+			if (input == 's')
+			{
+				fin.get(input);
+				if (input == 'e')
+				{
+					fin.get(input);
+					if (input == 'm')
+					{
+						fin.get(input);
+						if (input == 't')
+						{
+							fin.get(input);
+							if (input == 'l')
+							{
+								fin.get(input);
+								if (input == ' ')
+								{
+									if (objectIndex >= 0)
+									{
+										string& mtl = textureArray[objectIndex];
+										getline(fin, mtl);
+										if (!mtl.empty() && mtl[mtl.size() - 1] == '\r')
+										{
+											mtl.erase(mtl.size() - 1);
+										}
+										input = '\n';
+									}
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+
+		while (input != '\n' && !fin.eof())
+		{
+			fin.get(input);
+		}
+
+		// Start reading the beginning of the next line.
+		fin.get(input);
+
+	}
+
+	obj.faceCount = faceIndex;
+
+	return true;
+}
+
+
+bool ExpandFaces(const ObjData& obj, Arena& arena, Mesh& mesh)
+{
+	const VertexType* vertices = obj.vertices;
+	const VertexType* texcoords = obj.texcoords;
+	const VertexType* normals = obj.normals;
+	const FaceType* faces = obj.faces;
+	int vIndex, tIndex, nIndex;
+	const VertexType none = { 0.0f, 0.0f, 0.0f };
+
+	// Faces without normals need GenerateNormals() to have run.
+	if (obj.missingNormals && !obj.generatedNormals)
+	{
+		return false;
+	}
+
+	// Quads are split into two triangles.
+	ULONG vCount = 0;
+	for (int i = 0; i < obj.faceCount; i++)
+	{
+		vCount += faces[i].Count == 4 ? 6 : 3;
+	}
+
+	mesh.VertexCount = vCount;
+	mesh.IndexCount = vCount;
+	mesh.ObjectCount = obj.objectCount;
+	mesh.Instances = 0;
+	mesh.InstanceCount = 0;
+	mesh.Skin = 0;
+	mesh.BoneCount = 0;
+	mesh.Palettes = 0;
+	mesh.PaletteBones = 0;
+	mesh.PaletteBoneCount = 0;
+	mesh.Hulls = 0;
+	mesh.HullCount = 0;
+	mesh.HullVertices = 0;
+	mesh.HullVertexCount = 0;
+	mesh.HullIndices = 0;
+	mesh.HullIndexCount = 0;
+
+	vertexData* data = mesh.Vertices = arena.NewArray<vertexData>(mesh.VertexCount);
+	ULONG* Indices = mesh.Indices = arena.NewArray<ULONG>(mesh.IndexCount);
+	if (!data || !Indices)
+	{
+		return false;
+	}
+
+	for (ULONG i = 0; i < mesh.IndexCount; i++)
+	{
+		Indices[i] = i;
+	}
+
+	// Resolve each object's usemtl name to its material and diffuse map.
+	MatrialDesc* mA = mesh.Materials = arena.NewArray<MatrialDesc>(mesh.ObjectCount);
+	unsigned int* textureSize = mesh.TextureSize = arena.NewArray<unsigned int>(mesh.ObjectCount);
+	mesh.TextureName = arena.NewArray<const char*>(mesh.ObjectCount);
+	mesh.Subsets = arena.NewArray<SubsetTableDesc>(mesh.ObjectCount);
+	if (!mA || !textureSize || !mesh.TextureName || !mesh.Subsets)
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0; i < mesh.ObjectCount; i++)
+	{
+		string diffuseMap;
+		MtlLibrary::const_iterator it = obj.materials.find(obj.textureArray[i]);
+		if (it != obj.materials.end())
+		{
+			mA[i] = it->second.Material;
+			diffuseMap = it->second.DiffuseMap;
+		}
+		else
+		{
+			DefaultMaterial(&mA[i]);
+		}
+		textureSize[i] = diffuseMap.size() + 1;
+		mesh.TextureName[i] = CopyString(arena, diffuseMap);
+
+		mesh.Subsets[i].SubsetID = i;
+		mesh.Subsets[i].VertexStart = 0;
+		mesh.Subsets[i].VertexCount = 0;
+		mesh.Subsets[i].FaceStart = 0;
+		mesh.Subsets[i].FaceCount = 0;
+	}
+
+	int index = 0;
+	for (int i = 0; i < obj.faceCount; i++)
+	{
+		// Faces come in object order, so every subset is one contiguous range.
+		if (faces[i].ID < mesh.ObjectCount)
+		{
+			SubsetTableDesc& subset = mesh.Subsets[faces[i].ID];
+			if (subset.VertexCount == 0)
+			{
+				subset.VertexStart = index;
+				subset.FaceStart = index / 3;
+			}
+			subset.VertexCount += faces[i].Count == 4 ? 6 : 3;
+			subset.FaceCount += faces[i].Count == 4 ? 2 : 1;
+		}
+
+		// Quads are split along the diagonal from the second to the fourth corner.
+		static const int quadCorners[6] = { 1, 2, 3, 3, 0, 1 };
+		static const int triangleCorners[3] = { 0, 1, 2 };
+		const int* order = faces[i].Count == 4 ? quadCorners : triangleCorners;
+		int cornerCount = faces[i].Count == 4 ? 6 : 3;
+
+		const int* vIndices = &faces[i].vIndex1;
+		const int* tIndices = &faces[i].tIndex1;
+		const int* nIndices = &faces[i].nIndex1;
+		for (int c = 0; c < cornerCount; c++)
+		{
+			int k = order[c];
+			vIndex = vIndices[k] - 1;
+			tIndex = tIndices[k] - 1;
+			nIndex = nIndices[k] - 1;
+
+			// Corners without a texture coordinate map to the origin, and
+			// corners without a normal take the generated one.
+			const VertexType& t = tIndex >= 0 ? texcoords[tIndex] : none;
+			const VertexType& n = nIndex >= 0 ? normals[nIndex] : obj.generatedNormals[i * 4 + k];
+
+			insertData(&data[index], vertices[vIndex], t, n, faces[i].ID);
+
+			index++;
+		}
+	}
+
+	return true;
+}
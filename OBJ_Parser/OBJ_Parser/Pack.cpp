@@ -0,0 +1,279 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Pack.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstring>
+#include "Pack.h"
+using namespace std;
+
+
+static const char PACK_MAGIC[4] = { 'S', 'M', 'F', 'P' };
+static const UINT PACK_VERSION = 1;
+
+
+PackWriter::PackWriter()
+{
+	m_alignment = PACK_ALIGNMENT;
+}
+
+
+PackWriter::~PackWriter()
+{
+	if (m_out.is_open())
+	{
+		Close();
+	}
+}
+
+
+bool PackWriter::Open(const char* filename, UINT alignment)
+{
+	// The table of contents needs 8 byte alignment and the mask needs a power of two.
+	if (alignment < 8 || (alignment & (alignment - 1)) != 0)
+	{
+		return false;
+	}
+
+	m_out.open(filename, ios_base::binary | ios_base::trunc);
+	if (m_out.fail() == true)
+	{
+		return false;
+	}
+
+	m_alignment = alignment;
+	m_entries.clear();
+
+	// The header is written again by Close() once the offsets are known.
+	PackHeader head;
+	memset(&head, 0, sizeof(head));
+	m_out.write((char*)&head, sizeof(head));
+
+	return !m_out.fail();
+}
+
+
+bool PackWriter::Pad()
+{
+	static const char zeros[256] = { 0 };
+
+	unsigned long long position = (unsigned long long)m_out.tellp();
+	unsigned long long padding = (m_alignment - position % m_alignment) % m_alignment;
+	while (padding)
+	{
+		size_t count = padding < sizeof(zeros) ? (size_t)padding : sizeof(zeros);
+		m_out.write(zeros, count);
+		padding -= count;
+	}
+
+	return !m_out.fail();
+}
+
+
+bool PackWriter::Add(const string& name, const Mesh& mesh, UINT flags, Arena* scratch, unsigned long long* written)
+{
+	if (!m_out.is_open() || name.empty())
+	{
+		return false;
+	}
+
+	Pending entry;
+	entry.Name = name;
+	entry.Hash = PackHash(name.c_str(), name.size());
+	entry.Format = PACK_FORMAT_SMF;
+
+	for (size_t i = 0; i < m_entries.size(); i++)
+	{
+		if (m_entries[i].Hash == entry.Hash && m_entries[i].Name == name)
+		{
+			return false;
+		}
+	}
+
+	if (!Pad())
+	{
+		return false;
+	}
+
+	entry.Offset = (unsigned long long)m_out.tellp();
+	if (!WriteSMF(mesh, m_out, flags, scratch))
+	{
+		return false;
+	}
+	entry.Size = (unsigned long long)m_out.tellp() - entry.Offset;
+	if (written)
+	{
+		*written = entry.Size;
+	}
+
+	m_entries.push_back(entry);
+
+	return true;
+}
+
+
+bool PackWriter::Close()
+{
+	if (!m_out.is_open())
+	{
+		return false;
+	}
+
+	PackHeader head;
+	memcpy(head.Magic, PACK_MAGIC, sizeof(head.Magic));
+	head.Version = PACK_VERSION;
+	head.EntryCount = (UINT)m_entries.size();
+	head.SlotCount = 2;
+	while (head.SlotCount < head.EntryCount * 2)
+	{
+		head.SlotCount *= 2;
+	}
+	head.Alignment = m_alignment;
+	head.Reserved = 0;
+
+	// Fill the hash table and the name pool.
+	vector<PackEntry> slots(head.SlotCount);
+	memset(&slots[0], 0, sizeof(PackEntry) * slots.size());
+	string names;
+	for (size_t i = 0; i < m_entries.size(); i++)
+	{
+		const Pending& pending = m_entries[i];
+
+		UINT slot = (UINT)(pending.Hash & (head.SlotCount - 1));
+		while (slots[slot].Format != PACK_FORMAT_NONE)
+		{
+			slot = (slot + 1) & (head.SlotCount - 1);
+		}
+
+		PackEntry& entry = slots[slot];
+		entry.Hash = pending.Hash;
+		entry.Offset = pending.Offset;
+		entry.Size = pending.Size;
+		entry.NameOffset = (UINT)names.size();
+		entry.NameLength = (UINT)pending.Name.size();
+		entry.Format = pending.Format;
+		entry.Reserved = 0;
+
+		names += pending.Name;
+		names += '\0';
+	}
+
+	bool result = Pad();
+	head.TocOffset = (unsigned long long)m_out.tellp();
+	head.NamesOffset = head.TocOffset + sizeof(PackEntry) * slots.size();
+	head.NamesSize = names.size();
+
+	m_out.write((char*)&slots[0], sizeof(PackEntry) * slots.size());
+	m_out.write(names.data(), names.size());
+	m_out.seekp(0, ios_base::beg);
+	m_out.write((char*)&head, sizeof(head));
+
+	result = result && !m_out.fail();
+	m_out.close();
+	m_entries.clear();
+
+	return result;
+}
+
+
+unsigned long long PackHash(const char* name, size_t length)
+{
+	// 64 bit FNV-1a.
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)name[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+
+bool ReadPack(const char* data, size_t size, PackView& pack)
+{
+	if (size < sizeof(PackHeader))
+	{
+		return false;
+	}
+
+	const PackHeader* head = (const PackHeader*)data;
+	if (memcmp(head->Magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || head->Version > PACK_VERSION)
+	{
+		return false;
+	}
+
+	// The table needs an empty slot to end every probe.
+	if (head->SlotCount == 0 || (head->SlotCount & (head->SlotCount - 1)) != 0 || head->EntryCount >= head->SlotCount)
+	{
+		return false;
+	}
+
+	if (head->TocOffset % 8 != 0 || head->TocOffset > size ||
+		(unsigned long long)sizeof(PackEntry) * head->SlotCount > size - head->TocOffset ||
+		head->NamesOffset > size || head->NamesSize > size - head->NamesOffset)
+	{
+		return false;
+	}
+
+	pack.Data = data;
+	pack.Size = size;
+	pack.Head = head;
+	pack.Slots = (const PackEntry*)(data + head->TocOffset);
+	pack.Names = data + head->NamesOffset;
+
+	UINT used = 0;
+	for (UINT i = 0; i < head->SlotCount; i++)
+	{
+		const PackEntry& entry = pack.Slots[i];
+		if (entry.Format == PACK_FORMAT_NONE)
+		{
+			continue;
+		}
+
+		if (entry.Offset > size || entry.Size > size - entry.Offset ||
+			(unsigned long long)entry.NameOffset + entry.NameLength >= head->NamesSize)
+		{
+			return false;
+		}
+		used++;
+	}
+
+	return used == head->EntryCount;
+}
+
+
+const PackEntry* FindPackEntry(const PackView& pack, const char* name)
+{
+	size_t length = strlen(name);
+	unsigned long long hash = PackHash(name, length);
+	UINT mask = pack.Head->SlotCount - 1;
+
+	for (UINT slot = (UINT)(hash & mask); ; slot = (slot + 1) & mask)
+	{
+		const PackEntry& entry = pack.Slots[slot];
+		if (entry.Format == PACK_FORMAT_NONE)
+		{
+			return 0;
+		}
+
+		if (entry.Hash == hash && entry.NameLength == length && memcmp(pack.Names + entry.NameOffset, name, length) == 0)
+		{
+			return &entry;
+		}
+	}
+}
+
+
+bool ReadPackModel(const PackView& pack, const PackEntry& entry, Arena& arena, SMFView& view)
+{
+	if (entry.Format != PACK_FORMAT_SMF)
+	{
+		return false;
+	}
+
+	return ReadSMF(pack.Data + entry.Offset, (size_t)entry.Size, arena, view);
+}
@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Pack.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _PACK_H_
+#define _PACK_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <fstream>
+#include <string>
+#include <vector>
+#include "ModelParser.h"
+
+
+//////////////
+// TYPEDEFS //
+//////////////
+
+// A pack holds many models in one file: the PackHeader, the model blobs, each
+// starting on a multiple of Alignment, and at TocOffset a hash table of
+// SlotCount PackEntry slots followed by the name pool. SlotCount is a power of
+// two at least twice EntryCount and names are found by linear probing from
+// their hash, so a lookup touches a slot or two.
+struct PackHeader
+{
+	char Magic[4];
+	UINT Version;
+	UINT EntryCount;
+	UINT SlotCount;
+	UINT Alignment;
+	UINT Reserved;
+	unsigned long long TocOffset;
+	unsigned long long NamesOffset;
+	unsigned long long NamesSize;
+};
+
+// A slot with Format PACK_FORMAT_NONE is empty.
+struct PackEntry
+{
+	unsigned long long Hash;
+	unsigned long long Offset;
+	unsigned long long Size;
+	UINT NameOffset;
+	UINT NameLength;
+	UINT Format;
+	UINT Reserved;
+};
+
+enum PackFormat
+{
+	PACK_FORMAT_NONE = 0,
+	PACK_FORMAT_SMF = 1
+};
+
+static const UINT PACK_ALIGNMENT = 64;
+
+// A pack mapped over a buffer, checked by ReadPack.
+struct PackView
+{
+	const char* Data;
+	size_t Size;
+	const PackHeader* Head;
+	const PackEntry* Slots;
+	const char* Names;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: PackWriter
+// Writes converted models into a pack one at a time, so each model's arena can
+// be reset before the next one is converted. The table of contents is written
+// by Close().
+////////////////////////////////////////////////////////////////////////////////
+class PackWriter
+{
+public:
+	PackWriter();
+	~PackWriter();
+
+	bool Open(const char* filename, UINT alignment = PACK_ALIGNMENT);
+
+	// Adds a model as .smf data. Names have to be unique within the pack.
+	// written, if given, receives the size of the model's .smf data.
+	bool Add(const std::string& name, const Mesh& mesh, UINT flags = 0, Arena* scratch = 0, unsigned long long* written = 0);
+
+	bool Close();
+
+private:
+	PackWriter(const PackWriter&);
+	PackWriter& operator=(const PackWriter&);
+
+	bool Pad();
+
+private:
+	struct Pending
+	{
+		std::string Name;
+		unsigned long long Hash;
+		unsigned long long Offset;
+		unsigned long long Size;
+		UINT Format;
+	};
+
+	std::ofstream m_out;
+	UINT m_alignment;
+	std::vector<Pending> m_entries;
+};
+
+
+/////////////////////////
+// FUNCTION PROTOTYPES //
+/////////////////////////
+unsigned long long PackHash(const char* name, size_t length);
+bool ReadPack(const char* data, size_t size, PackView& pack);
+const PackEntry* FindPackEntry(const PackView& pack, const char* name);
+bool ReadPackModel(const PackView& pack, const PackEntry& entry, Arena& arena, SMFView& view);
+
+#endif
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Parallel.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include "Parallel.h"
+using namespace std;
+
+
+WorkerPool& WorkerPool::Shared()
+{
+	static WorkerPool pool;
+	return pool;
+}
+
+
+WorkerPool::WorkerPool()
+{
+	m_task = 0;
+	m_user = 0;
+	m_next = 0;
+	m_ranges = 0;
+	m_busy = 0;
+	m_stop = false;
+}
+
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+
+	for (size_t i = 0; i < m_threads.size(); i++)
+	{
+		m_threads[i].join();
+	}
+}
+
+
+size_t WorkerPool::Threads() const
+{
+	size_t threads = thread::hardware_concurrency();
+	return threads ? threads : 1;
+}
+
+
+void WorkerPool::Run(size_t ranges, Task task, void* user)
+{
+	// Workers are busy with another job, maybe the one calling.
+	unique_lock<mutex> running(m_running, try_to_lock);
+	if (!running.owns_lock())
+	{
+		for (size_t i = 0; i < ranges; i++)
+		{
+			task(i, user);
+		}
+		return;
+	}
+
+	unique_lock<mutex> lock(m_mutex);
+	while (m_threads.size() + 1 < Threads())
+	{
+		m_threads.push_back(thread(&WorkerPool::Work, this));
+	}
+
+	m_task = task;
+	m_user = user;
+	m_next = 0;
+	m_ranges = ranges;
+	m_wake.notify_all();
+
+	// The caller takes ranges too, then waits for those still running.
+	while (RunNext(lock))
+	{
+	}
+	m_done.wait(lock, [this] { return m_busy == 0; });
+	m_task = 0;
+}
+
+
+void WorkerPool::Work()
+{
+	unique_lock<mutex> lock(m_mutex);
+	while (!m_stop)
+	{
+		if (!RunNext(lock))
+		{
+			m_wake.wait(lock);
+		}
+	}
+}
+
+
+// Takes the next range of the current job and runs it unlocked. Returns false
+// when none is left.
+bool WorkerPool::RunNext(unique_lock<mutex>& lock)
+{
+	if (!m_task || m_next >= m_ranges)
+	{
+		return false;
+	}
+
+	Task task = m_task;
+	void* user = m_user;
+	size_t range = m_next++;
+	m_busy++;
+	lock.unlock();
+	task(range, user);
+	lock.lock();
+
+	if (--m_busy == 0 && m_next >= m_ranges)
+	{
+		m_done.notify_all();
+	}
+	return true;
+}
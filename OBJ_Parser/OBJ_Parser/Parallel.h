@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Parallel.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: WorkerPool
+// One thread per hardware thread but the caller's, started on first use and
+// kept waiting until the process exits, so a long-running converter does not
+// start threads for every stage of every file. One job runs at a time; a job
+// started while another runs, as from inside one, runs on its caller alone.
+////////////////////////////////////////////////////////////////////////////////
+class WorkerPool
+{
+public:
+	typedef void (*Task)(size_t range, void* user);
+
+	static WorkerPool& Shared();
+
+	~WorkerPool();
+
+	// Threads that can run ranges at once, the calling thread included.
+	size_t Threads() const;
+
+	// Runs task(i, user) for every i in [0, ranges) and returns when all have.
+	void Run(size_t ranges, Task task, void* user);
+
+private:
+	WorkerPool();
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+
+	void Work();
+	bool RunNext(std::unique_lock<std::mutex>& lock);
+
+private:
+	std::vector<std::thread> m_threads;
+	std::mutex m_running;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	Task m_task;
+	void* m_user;
+	size_t m_next;
+	size_t m_ranges;
+	size_t m_busy;
+	bool m_stop;
+};
+
+
+// Runs body(begin, end) over [0, count) split into one range per hardware
+// thread and run by the shared pool with the calling thread. Work below grain
+// items is not worth a thread and runs inline. Ranges must not write to shared
+// data.
+template <typename Body>
+void ParallelFor(size_t count, size_t grain, const Body& body)
+{
+	WorkerPool& pool = WorkerPool::Shared();
+	size_t threads = pool.Threads();
+	if (threads > count / (grain ? grain : 1))
+	{
+		threads = count / (grain ? grain : 1);
+	}
+	if (threads < 2)
+	{
+		body((size_t)0, count);
+		return;
+	}
+
+	struct Job
+	{
+		const Body* body;
+		size_t count;
+		size_t step;
+
+		static void Range(size_t range, void* user)
+		{
+			const Job* job = (const Job*)user;
+			size_t begin = range * job->step;
+			size_t end = begin + job->step < job->count ? begin + job->step : job->count;
+			(*job->body)(begin, end);
+		}
+	};
+
+	Job job = { &body, count, (count + threads - 1) / threads };
+	pool.Run((count + job.step - 1) / job.step, Job::Range, &job);
+}
+
+#endif
@@ -0,0 +1,631 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: SMFFile.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstring>
+#include <fstream>
+#include "ModelParser.h"
+using namespace DirectX;
+using namespace std;
+
+
+unsigned long long SMFSize(const Mesh& mesh, UINT flags)
+{
+	unsigned long long size = sizeof(Header);
+	size += (unsigned long long)sizeof(MatrialDesc) * mesh.ObjectCount;
+	size += (unsigned long long)sizeof(vertexData) * mesh.VertexCount;
+	size += (unsigned long long)sizeof(ULONG) * mesh.IndexCount;
+	size += (unsigned long long)sizeof(UINT) * mesh.ObjectCount;
+	for (UINT i = 0; i < mesh.ObjectCount; i++)
+	{
+		size += mesh.TextureSize[i];
+	}
+
+	// The sections WriteExtendedSMF() writes after the textures, in its order.
+	bool skin = (flags & SMF_WRITE_SKIN) != 0 && mesh.Skin;
+	unsigned long long trailing[4];
+	UINT trailingCount = 0;
+	if (mesh.InstanceCount)
+	{
+		trailing[trailingCount++] = (unsigned long long)sizeof(InstanceDesc) * mesh.InstanceCount;
+	}
+	if (skin)
+	{
+		trailing[trailingCount++] = (unsigned long long)sizeof(SkinVertex) * mesh.VertexCount;
+	}
+	if (skin && mesh.Palettes)
+	{
+		trailing[trailingCount++] = (unsigned long long)sizeof(BonePaletteDesc) * mesh.ObjectCount + (unsigned long long)sizeof(UINT) * mesh.PaletteBoneCount;
+	}
+	if (mesh.HullCount)
+	{
+		trailing[trailingCount++] = sizeof(CollisionHeader) + (unsigned long long)sizeof(HullDesc) * mesh.HullCount +
+			(unsigned long long)sizeof(XMFLOAT3) * mesh.HullVertexCount + (unsigned long long)sizeof(UINT) * mesh.HullIndexCount;
+	}
+
+	// The extension table, then every section starting on four bytes.
+	if ((flags & SMF_WRITE_COMPRESS) != 0 || trailingCount)
+	{
+		size += sizeof(SMFExtension) + sizeof(SMFSection) * (3 + trailingCount);
+	}
+	for (UINT i = 0; i < trailingCount; i++)
+	{
+		size = (size + 3) & ~3ull;
+		size += trailing[i];
+	}
+
+	return size;
+}
+
+
+static const char SMF_MAGIC[4] = { 'S', 'M', 'F', 'X' };
+static const UINT SMF_VERSION = 1;
+
+
+// Writes the texture size table followed by the names.
+static void WriteTextures(const Mesh& mesh, ostream& bout)
+{
+	bout.write((char*)mesh.TextureSize, sizeof(UINT)*mesh.ObjectCount);
+	for (UINT i = 0; i < mesh.ObjectCount; i++)
+	{
+		bout.write(mesh.TextureName[i], mesh.TextureSize[i]);
+	}
+}
+
+
+static unsigned long long TexturesSize(const Mesh& mesh)
+{
+	unsigned long long size = (unsigned long long)sizeof(UINT) * mesh.ObjectCount;
+	for (UINT i = 0; i < mesh.ObjectCount; i++)
+	{
+		size += mesh.TextureSize[i];
+	}
+
+	return size;
+}
+
+
+// Packed sections are padded so the section after them stays 4 byte aligned.
+static unsigned long long Padded(unsigned long long size)
+{
+	return (size + 3) & ~3ull;
+}
+
+
+// A raw section written after the textures, from up to four arrays.
+struct TrailingSection
+{
+	UINT Type;
+	const char* Data[4];
+	size_t Bytes[4];
+};
+
+
+// Writes a file with the extension table: packed or raw vertices and indices,
+// the textures and after them the instances, the skinning data and the
+// collision hulls, if any.
+static bool WriteExtendedSMF(const Mesh& mesh, ostream& bout, bool pack, bool skin, Arena& arena)
+{
+	const unsigned char* vertices = (const unsigned char*)mesh.Vertices;
+	const unsigned char* indices = (const unsigned char*)mesh.Indices;
+	size_t vertexBytes = sizeof(vertexData) * mesh.VertexCount;
+	size_t indexBytes = sizeof(ULONG) * mesh.IndexCount;
+	UINT encoding = pack ? SMF_ENCODING_PACKED : SMF_ENCODING_RAW;
+
+	if (pack && (!PackVertices(mesh.Vertices, mesh.VertexCount, arena, vertices, vertexBytes) ||
+		!PackIndices(mesh.Indices, mesh.IndexCount, arena, indices, indexBytes)))
+	{
+		return false;
+	}
+
+	TrailingSection trailing[4];
+	memset(trailing, 0, sizeof(trailing));
+	UINT trailingCount = 0;
+	if (mesh.InstanceCount)
+	{
+		TrailingSection& t = trailing[trailingCount++];
+		t.Type = SMF_SECTION_INSTANCES;
+		t.Data[0] = (const char*)mesh.Instances;
+		t.Bytes[0] = sizeof(InstanceDesc) * mesh.InstanceCount;
+	}
+	if (skin && mesh.Skin)
+	{
+		TrailingSection& t = trailing[trailingCount++];
+		t.Type = SMF_SECTION_SKIN;
+		t.Data[0] = (const char*)mesh.Skin;
+		t.Bytes[0] = sizeof(SkinVertex) * mesh.VertexCount;
+	}
+	if (skin && mesh.Skin && mesh.Palettes)
+	{
+		TrailingSection& t = trailing[trailingCount++];
+		t.Type = SMF_SECTION_PALETTES;
+		t.Data[0] = (const char*)mesh.Palettes;
+		t.Bytes[0] = sizeof(BonePaletteDesc) * mesh.ObjectCount;
+		t.Data[1] = (const char*)mesh.PaletteBones;
+		t.Bytes[1] = sizeof(UINT) * mesh.PaletteBoneCount;
+	}
+
+	CollisionHeader collision;
+	collision.HullCount = mesh.HullCount;
+	collision.VertexCount = mesh.HullVertexCount;
+	collision.IndexCount = mesh.HullIndexCount;
+	collision.Reserved = 0;
+	if (mesh.HullCount)
+	{
+		TrailingSection& t = trailing[trailingCount++];
+		t.Type = SMF_SECTION_COLLISION;
+		t.Data[0] = (const char*)&collision;
+		t.Bytes[0] = sizeof(CollisionHeader);
+		t.Data[1] = (const char*)mesh.Hulls;
+		t.Bytes[1] = sizeof(HullDesc) * mesh.HullCount;
+		t.Data[2] = (const char*)mesh.HullVertices;
+		t.Bytes[2] = sizeof(XMFLOAT3) * mesh.HullVertexCount;
+		t.Data[3] = (const char*)mesh.HullIndices;
+		t.Bytes[3] = sizeof(UINT) * mesh.HullIndexCount;
+	}
+
+	SMFExtension ext;
+	memcpy(ext.Magic, SMF_MAGIC, sizeof(ext.Magic));
+	ext.Version = SMF_VERSION;
+	ext.SectionCount = 3 + trailingCount;
+	ext.Reserved = 0;
+
+	Header head;
+	head.VertexCount = mesh.VertexCount;
+	head.IndexCount = mesh.IndexCount;
+	head.bfOffBits = sizeof(Header) + sizeof(SMFExtension) + sizeof(SMFSection) * ext.SectionCount;
+	head.ObjectCount = mesh.ObjectCount;
+
+	SMFSection sections[7];
+	sections[0].Type = SMF_SECTION_VERTICES;
+	sections[0].Encoding = encoding;
+	sections[0].Offset = head.bfOffBits + (unsigned long long)sizeof(MatrialDesc) * head.ObjectCount;
+	sections[0].Size = vertexBytes;
+	sections[1].Type = SMF_SECTION_INDICES;
+	sections[1].Encoding = encoding;
+	sections[1].Offset = sections[0].Offset + Padded(vertexBytes);
+	sections[1].Size = indexBytes;
+	sections[2].Type = SMF_SECTION_TEXTURES;
+	sections[2].Encoding = SMF_ENCODING_RAW;
+	sections[2].Offset = sections[1].Offset + Padded(indexBytes);
+	sections[2].Size = TexturesSize(mesh);
+	for (UINT i = 0; i < trailingCount; i++)
+	{
+		SMFSection& section = sections[3 + i];
+		section.Type = trailing[i].Type;
+		section.Encoding = SMF_ENCODING_RAW;
+		section.Offset = sections[2 + i].Offset + Padded(sections[2 + i].Size);
+		section.Size = trailing[i].Bytes[0] + trailing[i].Bytes[1] + trailing[i].Bytes[2] + trailing[i].Bytes[3];
+	}
+
+	static const char padding[4] = { 0, 0, 0, 0 };
+
+	bout.write((char*)&head, sizeof(Header));
+	bout.write((char*)&ext, sizeof(SMFExtension));
+	bout.write((char*)sections, sizeof(SMFSection) * ext.SectionCount);
+	bout.write((char*)mesh.Materials, sizeof(MatrialDesc)*head.ObjectCount);
+	bout.write((const char*)vertices, vertexBytes);
+	bout.write(padding, Padded(vertexBytes) - vertexBytes);
+	bout.write((const char*)indices, indexBytes);
+	bout.write(padding, Padded(indexBytes) - indexBytes);
+	WriteTextures(mesh, bout);
+	for (UINT i = 0; i < trailingCount; i++)
+	{
+		bout.write(padding, Padded(sections[2 + i].Size) - sections[2 + i].Size);
+		for (int k = 0; k < 4; k++)
+		{
+			bout.write(trailing[i].Data[k], trailing[i].Bytes[k]);
+		}
+	}
+
+	return !bout.fail();
+}
+
+
+static bool WriteAnySMF(const Mesh& mesh, ostream& bout, UINT flags, Arena* scratch)
+{
+	// Packed sections, instances, skinning and hulls need the extension table.
+	bool pack = (flags & SMF_WRITE_COMPRESS) != 0;
+	bool skin = (flags & SMF_WRITE_SKIN) != 0 && mesh.Skin;
+	if (pack || skin || mesh.InstanceCount || mesh.HullCount)
+	{
+		if (scratch)
+		{
+			return WriteExtendedSMF(mesh, bout, pack, skin, *scratch);
+		}
+
+		Arena arena;
+		return WriteExtendedSMF(mesh, bout, pack, skin, arena);
+	}
+
+	Header head;
+	head.VertexCount = mesh.VertexCount;
+	head.IndexCount = mesh.IndexCount;
+	head.bfOffBits = sizeof(Header);
+	head.ObjectCount = mesh.ObjectCount;
+
+	bout.write((char*)&head, sizeof(Header));
+	bout.write((char*)mesh.Materials, sizeof(MatrialDesc)*head.ObjectCount);
+
+	bout.write((char*)mesh.Vertices, sizeof(vertexData)*head.VertexCount);
+	bout.write((char*)mesh.Indices, sizeof(ULONG)*head.IndexCount);
+	WriteTextures(mesh, bout);
+
+	return !bout.fail();
+}
+
+
+bool WriteSMF(const Mesh& mesh, ostream& bout, UINT flags, Arena* scratch, unsigned long long* written)
+{
+	// Packed sections are only sized once they are packed, so the size
+	// written is measured rather than worked out.
+	streamoff start = written ? (streamoff)bout.tellp() : 0;
+	bool result = WriteAnySMF(mesh, bout, flags, scratch);
+	if (written)
+	{
+		streamoff end = (streamoff)bout.tellp();
+		*written = result && start >= 0 && end >= start ? (unsigned long long)(end - start) : 0;
+	}
+
+	return result;
+}
+
+
+bool WriteSMF(const Mesh& mesh, const char* filename, UINT flags, Arena* scratch, unsigned long long* written)
+{
+	ofstream bout;
+
+	bout.open(filename, ios_base::binary);
+	if (bout.fail() == true)
+	{
+		return false;
+	}
+
+	bool result = WriteSMF(mesh, bout, flags, scratch, written);
+
+	bout.close();
+
+	return result;
+}
+
+
+// Finds a section of the table, or returns 0.
+static const SMFSection* FindSection(const SMFView& view, UINT type)
+{
+	for (UINT i = 0; i < view.SectionCount; i++)
+	{
+		if (view.Sections[i].Type == type)
+		{
+			return &view.Sections[i];
+		}
+	}
+
+	return 0;
+}
+
+
+// Reads the extension table if the file has one.
+static bool ReadExtension(const char* data, size_t size, SMFView& view)
+{
+	const Header* head = view.Head;
+
+	view.Sections = 0;
+	view.SectionCount = 0;
+
+	if (head->bfOffBits < sizeof(Header) + sizeof(SMFExtension) ||
+		memcmp(data + sizeof(Header), SMF_MAGIC, sizeof(SMF_MAGIC)) != 0)
+	{
+		return true;
+	}
+
+	const SMFExtension* ext = (const SMFExtension*)(data + sizeof(Header));
+	unsigned long long tableEnd = sizeof(Header) + sizeof(SMFExtension) + (unsigned long long)sizeof(SMFSection) * ext->SectionCount;
+	if (ext->Version > SMF_VERSION || tableEnd > head->bfOffBits || tableEnd > size)
+	{
+		return false;
+	}
+
+	view.Sections = (const SMFSection*)(ext + 1);
+	view.SectionCount = ext->SectionCount;
+
+	for (UINT i = 0; i < view.SectionCount; i++)
+	{
+		const SMFSection& section = view.Sections[i];
+		if (section.Offset > size || section.Size > size - section.Offset || section.Offset % 4 != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+bool ReadSMFLayout(const char* data, size_t size, SMFView& view, SMFLayout& layout)
+{
+	const Header* head;
+
+	if (size < sizeof(Header))
+	{
+		return false;
+	}
+
+	head = view.Head = (const Header*)data;
+	if (head->bfOffBits < sizeof(Header) || head->bfOffBits > size || !ReadExtension(data, size, view))
+	{
+		return false;
+	}
+
+	// Every section has to lie inside the file.
+	unsigned long long offset = head->bfOffBits;
+	layout.MaterialOffset = offset;
+	offset += (unsigned long long)sizeof(MatrialDesc) * head->ObjectCount;
+
+	const SMFSection* vertices = FindSection(view, SMF_SECTION_VERTICES);
+	const SMFSection* indices = FindSection(view, SMF_SECTION_INDICES);
+	const SMFSection* textures = FindSection(view, SMF_SECTION_TEXTURES);
+	const SMFSection* instances = FindSection(view, SMF_SECTION_INSTANCES);
+	const SMFSection* skin = FindSection(view, SMF_SECTION_SKIN);
+	const SMFSection* palettes = FindSection(view, SMF_SECTION_PALETTES);
+	const SMFSection* collision = FindSection(view, SMF_SECTION_COLLISION);
+
+	layout.VertexOffset = vertices ? vertices->Offset : offset;
+	layout.VertexBytes = vertices ? vertices->Size : (unsigned long long)sizeof(vertexData) * head->VertexCount;
+	layout.VertexEncoding = vertices ? (UINT)vertices->Encoding : (UINT)SMF_ENCODING_RAW;
+	offset = layout.VertexOffset + layout.VertexBytes;
+
+	layout.IndexOffset = indices ? indices->Offset : offset;
+	layout.IndexBytes = indices ? indices->Size : (unsigned long long)sizeof(ULONG) * head->IndexCount;
+	layout.IndexEncoding = indices ? (UINT)indices->Encoding : (UINT)SMF_ENCODING_RAW;
+	offset = layout.IndexOffset + layout.IndexBytes;
+
+	layout.TextureOffset = textures ? textures->Offset : offset;
+	layout.TextureEnd = textures ? textures->Offset + textures->Size : size;
+
+	layout.InstanceOffset = instances ? instances->Offset : 0;
+	layout.InstanceCount = instances ? (UINT)(instances->Size / sizeof(InstanceDesc)) : 0;
+	if (instances && (instances->Encoding != SMF_ENCODING_RAW || instances->Size % sizeof(InstanceDesc) != 0))
+	{
+		return false;
+	}
+
+	// Palettes only mean something for skinned vertices.
+	layout.SkinOffset = skin ? skin->Offset : 0;
+	layout.PaletteOffset = palettes ? palettes->Offset : 0;
+	layout.PaletteBytes = palettes ? palettes->Size : 0;
+	if (skin && (skin->Encoding != SMF_ENCODING_RAW || skin->Size != (unsigned long long)sizeof(SkinVertex) * head->VertexCount))
+	{
+		return false;
+	}
+	if (palettes && (!skin || palettes->Encoding != SMF_ENCODING_RAW ||
+		palettes->Size < (unsigned long long)sizeof(BonePaletteDesc) * head->ObjectCount ||
+		(palettes->Size - sizeof(BonePaletteDesc) * head->ObjectCount) % sizeof(UINT) != 0))
+	{
+		return false;
+	}
+
+	layout.CollisionOffset = collision ? collision->Offset : 0;
+	layout.CollisionBytes = collision ? collision->Size : 0;
+	if (collision && (collision->Encoding != SMF_ENCODING_RAW || collision->Size < sizeof(CollisionHeader)))
+	{
+		return false;
+	}
+
+	// Streaming readers need the file up to the end of its last section.
+	layout.SectionEnd = layout.TextureEnd;
+	for (UINT i = 0; i < view.SectionCount; i++)
+	{
+		unsigned long long end = view.Sections[i].Offset + view.Sections[i].Size;
+		layout.SectionEnd = end > layout.SectionEnd ? end : layout.SectionEnd;
+	}
+
+	// Raw sections are used in place and have to be exactly their arrays.
+	if ((layout.VertexEncoding == SMF_ENCODING_RAW && layout.VertexBytes != (unsigned long long)sizeof(vertexData) * head->VertexCount) ||
+		(layout.IndexEncoding == SMF_ENCODING_RAW && layout.IndexBytes != (unsigned long long)sizeof(ULONG) * head->IndexCount))
+	{
+		return false;
+	}
+
+	return layout.MaterialOffset + (unsigned long long)sizeof(MatrialDesc) * head->ObjectCount <= size &&
+		layout.VertexOffset + layout.VertexBytes <= size &&
+		layout.IndexOffset + layout.IndexBytes <= size &&
+		layout.TextureOffset <= layout.TextureEnd && layout.TextureEnd <= size;
+}
+
+
+bool ReadSMFTextures(const char* data, const SMFLayout& layout, Arena& arena, SMFView& view)
+{
+	const Header* head = view.Head;
+	unsigned long long offset = layout.TextureOffset;
+
+	if (offset + (unsigned long long)sizeof(UINT) * head->ObjectCount > layout.TextureEnd)
+	{
+		return false;
+	}
+	view.TextureSize = (const UINT*)(data + offset);
+	offset += sizeof(UINT) * head->ObjectCount;
+
+	view.TextureName = arena.NewArray<const char*>(head->ObjectCount);
+	if (!view.TextureName)
+	{
+		return false;
+	}
+
+	for (UINT i = 0; i < head->ObjectCount; i++)
+	{
+		if (offset + view.TextureSize[i] > layout.TextureEnd)
+		{
+			return false;
+		}
+
+		view.TextureName[i] = data + offset;
+		offset += view.TextureSize[i];
+	}
+
+	return true;
+}
+
+
+bool ReadSMFInstances(const char* data, const SMFLayout& layout, SMFView& view)
+{
+	view.Instances = layout.InstanceCount ? (const InstanceDesc*)(data + layout.InstanceOffset) : 0;
+	view.InstanceCount = layout.InstanceCount;
+
+	for (UINT i = 0; i < view.InstanceCount; i++)
+	{
+		if (view.Instances[i].SubsetID >= view.Head->ObjectCount || view.Instances[i].ObjectID >= view.Head->ObjectCount)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+bool ReadSMFSkin(const char* data, const SMFLayout& layout, SMFView& view)
+{
+	const Header* head = view.Head;
+
+	view.Skin = layout.SkinOffset ? (const SkinVertex*)(data + layout.SkinOffset) : 0;
+	view.Palettes = 0;
+	view.PaletteBones = 0;
+	view.PaletteBoneCount = 0;
+	if (!layout.PaletteOffset)
+	{
+		return true;
+	}
+
+	view.Palettes = (const BonePaletteDesc*)(data + layout.PaletteOffset);
+	view.PaletteBones = (const UINT*)(view.Palettes + head->ObjectCount);
+	view.PaletteBoneCount = (UINT)((layout.PaletteBytes - sizeof(BonePaletteDesc) * head->ObjectCount) / sizeof(UINT));
+
+	for (UINT i = 0; i < head->ObjectCount; i++)
+	{
+		if (view.Palettes[i].Start > view.PaletteBoneCount || view.Palettes[i].Count > view.PaletteBoneCount - view.Palettes[i].Start)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+bool ReadSMFCollision(const char* data, const SMFLayout& layout, SMFView& view)
+{
+	view.Hulls = 0;
+	view.HullCount = 0;
+	view.HullVertices = 0;
+	view.HullVertexCount = 0;
+	view.HullIndices = 0;
+	view.HullIndexCount = 0;
+	if (!layout.CollisionOffset)
+	{
+		return true;
+	}
+
+	const CollisionHeader* collision = (const CollisionHeader*)(data + layout.CollisionOffset);
+	unsigned long long bytes = sizeof(CollisionHeader) + (unsigned long long)sizeof(HullDesc) * collision->HullCount +
+		(unsigned long long)sizeof(XMFLOAT3) * collision->VertexCount + (unsigned long long)sizeof(UINT) * collision->IndexCount;
+	if (bytes != layout.CollisionBytes)
+	{
+		return false;
+	}
+
+	view.Hulls = (const HullDesc*)(collision + 1);
+	view.HullCount = collision->HullCount;
+	view.HullVertices = (const XMFLOAT3*)(view.Hulls + view.HullCount);
+	view.HullVertexCount = collision->VertexCount;
+	view.HullIndices = (const UINT*)(view.HullVertices + view.HullVertexCount);
+	view.HullIndexCount = collision->IndexCount;
+
+	// Hulls have to stay inside the arrays and their triangles inside the hull.
+	for (UINT i = 0; i < view.HullCount; i++)
+	{
+		const HullDesc& hull = view.Hulls[i];
+		if (hull.SubsetID >= view.Head->ObjectCount ||
+			hull.VertexStart > view.HullVertexCount || hull.VertexCount > view.HullVertexCount - hull.VertexStart ||
+			hull.IndexStart > view.HullIndexCount || hull.IndexCount > view.HullIndexCount - hull.IndexStart || hull.IndexCount % 3 != 0)
+		{
+			return false;
+		}
+
+		for (UINT k = 0; k < hull.IndexCount; k++)
+		{
+			if (view.HullIndices[hull.IndexStart + k] >= hull.VertexCount)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+bool ReadSMF(const char* data, size_t size, Arena& arena, SMFView& view)
+{
+	SMFLayout layout;
+
+	if (!ReadSMFLayout(data, size, view, layout))
+	{
+		return false;
+	}
+
+	const Header* head = view.Head;
+	const unsigned char* vertices = (const unsigned char*)(data + layout.VertexOffset);
+	const unsigned char* indices = (const unsigned char*)(data + layout.IndexOffset);
+
+	view.Materials = (const MatrialDesc*)(data + layout.MaterialOffset);
+
+	// Raw sections are used in place, packed ones are decoded into the arena.
+	if (layout.VertexEncoding == SMF_ENCODING_RAW)
+	{
+		view.Vertices = (const vertexData*)vertices;
+	}
+	else
+	{
+		vertexData* decoded = arena.NewArray<vertexData>(head->VertexCount);
+		if (layout.VertexEncoding != SMF_ENCODING_PACKED || !decoded || !UnpackVertices(vertices, (size_t)layout.VertexBytes, decoded, head->VertexCount, arena))
+		{
+			return false;
+		}
+		view.Vertices = decoded;
+	}
+
+	if (layout.IndexEncoding == SMF_ENCODING_RAW)
+	{
+		view.Indices = (const ULONG*)indices;
+	}
+	else
+	{
+		ULONG* decoded = arena.NewArray<ULONG>(head->IndexCount);
+		if (layout.IndexEncoding != SMF_ENCODING_PACKED || !decoded || !UnpackIndices(indices, (size_t)layout.IndexBytes, decoded, head->IndexCount, arena))
+		{
+			return false;
+		}
+		view.Indices = decoded;
+	}
+
+	return ReadSMFTextures(data, layout, arena, view) && ReadSMFInstances(data, layout, view) && ReadSMFSkin(data, layout, view) &&
+		ReadSMFCollision(data, layout, view);
+}
+
+
+bool LoadSMF(const char* filename, Arena& arena, SMFView& view)
+{
+	size_t size;
+
+	char* data = ReadWholeFile(filename, arena, size);
+	if (!data)
+	{
+		return false;
+	}
+
+	return ReadSMF(data, size, arena, view);
+}
@@ -0,0 +1,419 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: SMFStreamLoader.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include "SMFStreamLoader.h"
+using namespace std;
+
+
+// Bytes the read thread reads before publishing them. The caller works on one
+// chunk while the next is being read.
+static const size_t READ_CHUNK = 1 << 18;
+
+
+// The bytes of a section that have arrived.
+static size_t SectionArrived(size_t available, unsigned long long offset, unsigned long long bytes)
+{
+	if (available <= offset)
+	{
+		return 0;
+	}
+	return available - offset < bytes ? (size_t)(available - offset) : (size_t)bytes;
+}
+
+
+SMFStreamLoader::SMFStreamLoader()
+{
+	m_available = 0;
+	m_readFailed = false;
+	m_arena = 0;
+	m_data = 0;
+	m_size = 0;
+	m_consumed = 0;
+	m_state = STATE_FAILED;
+	m_scanned = 0;
+	m_runLastVertex = 0;
+	m_decodedVertices = 0;
+	m_decodedIndices = 0;
+	m_verticesReady = 0;
+	m_indicesReady = 0;
+}
+
+
+SMFStreamLoader::~SMFStreamLoader()
+{
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+
+bool SMFStreamLoader::Start(const char* filename, Arena& arena)
+{
+	if (m_thread.joinable())
+	{
+		return false;
+	}
+
+	// Open the file at its end to get the size.
+	m_file.open(filename, ios_base::binary | ios_base::ate);
+	if (m_file.fail() == true)
+	{
+		return false;
+	}
+
+	streamoff length = m_file.tellg();
+	if (length < 0)
+	{
+		m_file.close();
+		return false;
+	}
+	m_file.seekg(0, ios_base::beg);
+
+	m_size = (size_t)length;
+	m_data = (char*)arena.Alloc(m_size + 1);
+	if (!m_data)
+	{
+		m_file.close();
+		return false;
+	}
+	m_data[m_size] = '\0';
+
+	m_arena = &arena;
+	m_available = 0;
+	m_readFailed = false;
+	m_consumed = 0;
+	m_state = STATE_HEADER;
+	m_scanned = 0;
+	m_run.FaceCount = 0;
+
+	m_thread = thread(&SMFStreamLoader::ReadThread, this);
+
+	return true;
+}
+
+
+void SMFStreamLoader::ReadThread()
+{
+	size_t offset = 0;
+	while (offset < m_size)
+	{
+		size_t count = m_size - offset < READ_CHUNK ? m_size - offset : READ_CHUNK;
+		if (!m_file.read(m_data + offset, count))
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_readFailed = true;
+			m_arrived.notify_one();
+			break;
+		}
+		offset += count;
+
+		lock_guard<mutex> lock(m_mutex);
+		m_available = offset;
+		m_arrived.notify_one();
+	}
+
+	m_file.close();
+}
+
+
+bool SMFStreamLoader::Poll(SubsetCallback callback, void* user, bool wait)
+{
+	if (m_state == STATE_DONE || m_state == STATE_FAILED)
+	{
+		return false;
+	}
+
+	size_t available;
+	bool readFailed;
+	{
+		unique_lock<mutex> lock(m_mutex);
+		if (wait)
+		{
+			m_arrived.wait(lock, [this]() { return m_available > m_consumed || m_available == m_size || m_readFailed; });
+		}
+		available = m_available;
+		readFailed = m_readFailed;
+	}
+	m_consumed = available;
+
+	if (readFailed)
+	{
+		m_state = STATE_FAILED;
+		return false;
+	}
+
+	Advance(available, callback, user);
+
+	// A file that ends before its sections do is truncated.
+	if (available == m_size && m_state != STATE_DONE)
+	{
+		m_state = STATE_FAILED;
+	}
+
+	return m_state != STATE_DONE && m_state != STATE_FAILED;
+}
+
+
+bool SMFStreamLoader::Finish(SubsetCallback callback, void* user, SMFView& view)
+{
+	while (Poll(callback, user, true))
+	{
+	}
+
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+
+	view = m_view;
+
+	return m_state == STATE_DONE;
+}
+
+
+bool SMFStreamLoader::Failed() const
+{
+	return m_state == STATE_FAILED;
+}
+
+
+void SMFStreamLoader::Advance(size_t available, SubsetCallback callback, void* user)
+{
+	const Header* head = (const Header*)m_data;
+
+	if (m_state == STATE_HEADER)
+	{
+		// The layout needs the header, the extension table and the materials.
+		if (available < sizeof(Header) || available < head->bfOffBits)
+		{
+			return;
+		}
+		if (!ReadSMFLayout(m_data, m_size, m_view, m_layout))
+		{
+			m_state = STATE_FAILED;
+			return;
+		}
+		if (available < m_layout.MaterialOffset + (unsigned long long)sizeof(MatrialDesc) * head->ObjectCount)
+		{
+			return;
+		}
+
+		m_view.Materials = (const MatrialDesc*)(m_data + m_layout.MaterialOffset);
+		m_view.Vertices = 0;
+		m_view.Indices = 0;
+		m_view.TextureSize = 0;
+		m_view.TextureName = 0;
+		m_view.Instances = 0;
+		m_view.InstanceCount = 0;
+		m_view.Skin = 0;
+		m_view.Palettes = 0;
+		m_view.PaletteBones = 0;
+		m_view.PaletteBoneCount = 0;
+		m_view.Hulls = 0;
+		m_view.HullCount = 0;
+		m_view.HullVertices = 0;
+		m_view.HullVertexCount = 0;
+		m_view.HullIndices = 0;
+		m_view.HullIndexCount = 0;
+
+		// Packed sections decode into the arena a chunk at a time as they
+		// arrive, raw ones are used where they land.
+		const unsigned char* vertexBytes = (const unsigned char*)(m_data + m_layout.VertexOffset);
+		const unsigned char* indexBytes = (const unsigned char*)(m_data + m_layout.IndexOffset);
+		if (m_layout.VertexEncoding == SMF_ENCODING_RAW)
+		{
+			m_view.Vertices = (const vertexData*)vertexBytes;
+		}
+		else
+		{
+			m_decodedVertices = m_arena->NewArray<vertexData>(head->VertexCount);
+			if (m_layout.VertexEncoding != SMF_ENCODING_PACKED || !m_decodedVertices || !BeginUnpackVertices(m_vertexUnpacker, vertexBytes, *m_arena))
+			{
+				m_state = STATE_FAILED;
+				return;
+			}
+			m_view.Vertices = m_decodedVertices;
+		}
+		if (m_layout.IndexEncoding == SMF_ENCODING_RAW)
+		{
+			m_view.Indices = (const ULONG*)indexBytes;
+		}
+		else
+		{
+			m_decodedIndices = m_arena->NewArray<ULONG>(head->IndexCount);
+			if (m_layout.IndexEncoding != SMF_ENCODING_PACKED || !m_decodedIndices || !BeginUnpackIndices(m_indexUnpacker, indexBytes, *m_arena))
+			{
+				m_state = STATE_FAILED;
+				return;
+			}
+			m_view.Indices = m_decodedIndices;
+		}
+		m_verticesReady = 0;
+		m_indicesReady = 0;
+		m_state = STATE_VERTICES;
+	}
+
+	if (m_state == STATE_VERTICES)
+	{
+		// Vertices come before the indices that use them, so the first range
+		// waits for the whole section. Decoding it as it arrives still keeps
+		// that wait down to the last chunk.
+		const unsigned char* bytes = (const unsigned char*)(m_data + m_layout.VertexOffset);
+		size_t arrived = SectionArrived(available, m_layout.VertexOffset, m_layout.VertexBytes);
+		if (m_layout.VertexEncoding == SMF_ENCODING_RAW)
+		{
+			m_verticesReady = arrived / sizeof(vertexData) < head->VertexCount ? (ULONG)(arrived / sizeof(vertexData)) : head->VertexCount;
+		}
+		else
+		{
+			ULONG done;
+			do
+			{
+				done = m_vertexUnpacker.Done;
+				if (!UnpackVertexChunk(m_vertexUnpacker, bytes + arrived, m_decodedVertices, head->VertexCount))
+				{
+					m_state = STATE_FAILED;
+					return;
+				}
+			} while (m_vertexUnpacker.Done != done);
+			m_verticesReady = m_vertexUnpacker.Done;
+			if (arrived == m_layout.VertexBytes && (m_verticesReady < head->VertexCount || m_vertexUnpacker.Next != bytes + arrived))
+			{
+				m_state = STATE_FAILED;
+				return;
+			}
+		}
+		if (m_verticesReady < head->VertexCount)
+		{
+			return;
+		}
+		m_state = STATE_INDICES;
+	}
+
+	if (m_state == STATE_INDICES)
+	{
+		// Indices are used as they arrive, a whole triangle at a time. Packed
+		// ones are scanned after every chunk, so the first ranges go out
+		// before the rest of the section is decoded.
+		const unsigned char* bytes = (const unsigned char*)(m_data + m_layout.IndexOffset);
+		size_t arrived = SectionArrived(available, m_layout.IndexOffset, m_layout.IndexBytes);
+		ULONG done;
+		do
+		{
+			done = m_indicesReady;
+			if (m_layout.IndexEncoding == SMF_ENCODING_RAW)
+			{
+				m_indicesReady = arrived / sizeof(ULONG) < head->IndexCount ? (ULONG)(arrived / sizeof(ULONG)) : head->IndexCount;
+			}
+			else
+			{
+				if (!UnpackIndexChunk(m_indexUnpacker, bytes + arrived, m_decodedIndices, head->IndexCount))
+				{
+					m_state = STATE_FAILED;
+					return;
+				}
+				m_indicesReady = m_indexUnpacker.Done;
+			}
+
+			if (!ScanTriangles(m_indicesReady / 3 * 3, callback, user))
+			{
+				m_state = STATE_FAILED;
+				return;
+			}
+
+			// The run scanned so far can be drawn while the rest of it is still
+			// on its way.
+			EmitRun(callback, user);
+		} while (m_indicesReady != done);
+
+		if (m_layout.IndexEncoding != SMF_ENCODING_RAW && arrived == m_layout.IndexBytes &&
+			(m_indicesReady < head->IndexCount || m_indexUnpacker.Next != bytes + arrived))
+		{
+			m_state = STATE_FAILED;
+			return;
+		}
+		if (m_scanned < head->IndexCount / 3 * 3)
+		{
+			return;
+		}
+		m_state = STATE_TEXTURES;
+	}
+
+	if (m_state == STATE_TEXTURES)
+	{
+		if (available < m_layout.SectionEnd)
+		{
+			return;
+		}
+		if (!ReadSMFTextures(m_data, m_layout, *m_arena, m_view) || !ReadSMFInstances(m_data, m_layout, m_view) ||
+			!ReadSMFSkin(m_data, m_layout, m_view) || !ReadSMFCollision(m_data, m_layout, m_view))
+		{
+			m_state = STATE_FAILED;
+			return;
+		}
+		m_state = STATE_DONE;
+	}
+}
+
+
+bool SMFStreamLoader::ScanTriangles(ULONG end, SubsetCallback callback, void* user)
+{
+	const Header* head = m_view.Head;
+
+	// Consecutive triangles of one subset form a run. A triangle belongs to
+	// the subset of its first vertex, and a run is handed out once a triangle
+	// of another subset follows it or the triangles that have arrived run out.
+	for (; m_scanned < end; m_scanned += 3)
+	{
+		ULONG a = m_view.Indices[m_scanned];
+		ULONG b = m_view.Indices[m_scanned + 1];
+		ULONG c = m_view.Indices[m_scanned + 2];
+		if (a >= head->VertexCount || b >= head->VertexCount || c >= head->VertexCount)
+		{
+			return false;
+		}
+
+		UINT id = m_view.Vertices[a].ID;
+		if (m_run.FaceCount && m_run.SubsetID != id)
+		{
+			EmitRun(callback, user);
+		}
+		if (!m_run.FaceCount)
+		{
+			m_run.SubsetID = id;
+			m_run.FaceStart = m_scanned / 3;
+			m_run.VertexStart = a;
+			m_runLastVertex = a;
+		}
+
+		m_run.FaceCount++;
+		ULONG low = a < b ? (a < c ? a : c) : (b < c ? b : c);
+		ULONG high = a > b ? (a > c ? a : c) : (b > c ? b : c);
+		m_run.VertexStart = low < m_run.VertexStart ? low : m_run.VertexStart;
+		m_runLastVertex = high > m_runLastVertex ? high : m_runLastVertex;
+	}
+
+	return true;
+}
+
+
+void SMFStreamLoader::EmitRun(SubsetCallback callback, void* user)
+{
+	if (!m_run.FaceCount)
+	{
+		return;
+	}
+
+	m_run.VertexCount = m_runLastVertex - m_run.VertexStart + 1;
+	if (callback)
+	{
+		callback(m_view, m_run, user);
+	}
+	m_run.FaceCount = 0;
+}
@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: SMFStreamLoader.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _SMFSTREAMLOADER_H_
+#define _SMFSTREAMLOADER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include "ModelParser.h"
+
+
+//////////////
+// TYPEDEFS //
+//////////////
+
+// Receives a run of triangles that can be drawn. FaceStart and FaceCount are
+// in triangles, VertexStart and VertexCount cover the vertices they use. The
+// view holds everything that has arrived; TextureName, Instances and the
+// skinning data are only set once the load has finished.
+typedef void (*SubsetCallback)(const SMFView& view, const SubsetTableDesc& range, void* user);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: SMFStreamLoader
+// Loads a .smf file progressively. A background thread reads the file into
+// the arena buffer chunk by chunk while the caller's thread decodes and scans
+// whatever has arrived and calls back for every subset range that has become
+// usable, so the first triangles can be drawn while the rest is still on its
+// way. Packed sections are decoded a chunk at a time as they land. All
+// vertices precede the indices in the file, so the first range is only
+// handed out once the whole vertex section is in; ranges then follow the
+// indices as they arrive, and a subset may come in several runs.
+// Callbacks run on the thread calling Poll() or Finish(), and the arena must
+// not be used elsewhere until the load has finished.
+////////////////////////////////////////////////////////////////////////////////
+class SMFStreamLoader
+{
+public:
+	SMFStreamLoader();
+	~SMFStreamLoader();
+
+	// Takes the file buffer from the arena and starts reading.
+	bool Start(const char* filename, Arena& arena);
+
+	// Delivers the ranges that became usable since the last call. With wait set
+	// it blocks until more of the file is in. Returns false once the load has
+	// finished or failed.
+	bool Poll(SubsetCallback callback, void* user, bool wait);
+
+	// Delivers everything that is left and returns the complete view.
+	bool Finish(SubsetCallback callback, void* user, SMFView& view);
+
+	bool Failed() const;
+
+private:
+	SMFStreamLoader(const SMFStreamLoader&);
+	SMFStreamLoader& operator=(const SMFStreamLoader&);
+
+	enum State
+	{
+		STATE_HEADER,
+		STATE_VERTICES,
+		STATE_INDICES,
+		STATE_TEXTURES,
+		STATE_DONE,
+		STATE_FAILED
+	};
+
+	void ReadThread();
+	void Advance(size_t available, SubsetCallback callback, void* user);
+	bool ScanTriangles(ULONG end, SubsetCallback callback, void* user);
+	void EmitRun(SubsetCallback callback, void* user);
+
+private:
+	// Shared with the read thread.
+	std::ifstream m_file;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_arrived;
+	size_t m_available;
+	bool m_readFailed;
+
+	// Owned by the caller's thread.
+	Arena* m_arena;
+	char* m_data;
+	size_t m_size;
+	size_t m_consumed;
+	State m_state;
+	SMFView m_view;
+	SMFLayout m_layout;
+	ULONG m_scanned;
+	SubsetTableDesc m_run;
+	ULONG m_runLastVertex;
+	vertexData* m_decodedVertices;
+	ULONG* m_decodedIndices;
+	SectionUnpacker m_vertexUnpacker;
+	SectionUnpacker m_indexUnpacker;
+	ULONG m_verticesReady;
+	ULONG m_indicesReady;
+};
+
+#endif
@@ -0,0 +1,16 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Simd.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+
+// MODEL_SSE2 is defined where SSE2 can be used without a runtime check: every
+// x64 target and x86 builds that ask for it. Code without it keeps a scalar
+// path that gives the same results.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MODEL_SSE2
+#endif
+
+#endif
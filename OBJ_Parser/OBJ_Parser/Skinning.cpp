@@ -0,0 +1,299 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Skinning.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <vector>
+#include "ModelParser.h"
+using namespace std;
+
+
+// A vertex names up to four bones, so a triangle can need twelve.
+static const UINT MIN_PALETTE = 12;
+static const UINT MAX_BONES = 256;
+
+
+// A run of one subset's triangles whose bones fit a palette.
+struct PalettePiece
+{
+	UINT Subset;
+	UINT NewSubset;
+	ULONG TriangleStart;
+	ULONG TriangleCount;
+	UINT BoneStart;
+	UINT BoneCount;
+	ULONG VertexCount;
+};
+
+
+// Adds the bones a vertex is weighted to that are not in the palette yet.
+static void GatherBones(const SkinVertex& skin, UINT stamp, const UINT* stamps, UINT* found, UINT& count)
+{
+	const float* weights = &skin.BlendWeights.x;
+	for (int k = 0; k < 4; k++)
+	{
+		UINT bone = skin.BlendIndices[k];
+		if (weights[k] == 0.0f || stamps[bone] == stamp)
+		{
+			continue;
+		}
+
+		bool seen = false;
+		for (UINT i = 0; i < count; i++)
+		{
+			seen = seen || found[i] == bone;
+		}
+		if (!seen)
+		{
+			found[count++] = bone;
+		}
+	}
+}
+
+
+bool SplitBonePalettes(Mesh& mesh, UINT paletteSize, Arena& arena)
+{
+	if (!mesh.Skin)
+	{
+		return true;
+	}
+	if (paletteSize < MIN_PALETTE || paletteSize > MAX_BONES || mesh.BoneCount > MAX_BONES)
+	{
+		return false;
+	}
+
+	UINT objects = mesh.ObjectCount;
+	ULONG triangleCount = mesh.IndexCount / 3;
+
+	// Group the triangles by subset, keeping their order. Every triangle is
+	// rewritten into some piece, so one of no subset can not be split.
+	SubsetTriangles groups;
+	if (!GroupTrianglesBySubset(mesh, arena, groups) || groups.Start[objects] != triangleCount)
+	{
+		return false;
+	}
+	const ULONG* order = groups.Order;
+	const ULONG* subsetStart = groups.Start;
+
+	for (ULONG i = 0; i < mesh.VertexCount; i++)
+	{
+		for (int k = 0; k < 4; k++)
+		{
+			if (mesh.Skin[i].BlendIndices[k] >= mesh.BoneCount && (&mesh.Skin[i].BlendWeights.x)[k] != 0.0f)
+			{
+				return false;
+			}
+		}
+	}
+
+	// Cut every subset into pieces greedily, in triangle order: a triangle
+	// that would push the palette over the limit starts the next piece.
+	vector<PalettePiece> pieces;
+	vector<UINT> bones;
+	UINT stamps[MAX_BONES];
+	UINT localOf[MAX_BONES];
+	UINT stamp = 0;
+	for (UINT i = 0; i < MAX_BONES; i++)
+	{
+		stamps[i] = 0;
+	}
+
+	UINT extra = 0;
+	for (UINT s = 0; s < objects; s++)
+	{
+		PalettePiece piece;
+		piece.Subset = s;
+		piece.NewSubset = s;
+		piece.TriangleStart = subsetStart[s];
+		piece.TriangleCount = 0;
+		piece.BoneStart = (UINT)bones.size();
+		piece.BoneCount = 0;
+		stamp++;
+
+		for (ULONG i = subsetStart[s]; i < subsetStart[s + 1]; i++)
+		{
+			const ULONG* index = mesh.Indices + order[i] * 3;
+			UINT found[12];
+			UINT count = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				GatherBones(mesh.Skin[index[k]], stamp, stamps, found, count);
+			}
+
+			if (piece.BoneCount + count > paletteSize)
+			{
+				pieces.push_back(piece);
+				piece.NewSubset = objects + extra++;
+				piece.TriangleStart = i;
+				piece.TriangleCount = 0;
+				piece.BoneStart = (UINT)bones.size();
+				piece.BoneCount = 0;
+				stamp++;
+
+				// Bones the last piece had count again.
+				count = 0;
+				for (int k = 0; k < 3; k++)
+				{
+					GatherBones(mesh.Skin[index[k]], stamp, stamps, found, count);
+				}
+			}
+
+			for (UINT k = 0; k < count; k++)
+			{
+				stamps[found[k]] = stamp;
+				localOf[found[k]] = piece.BoneCount++;
+				bones.push_back(found[k]);
+			}
+			piece.TriangleCount++;
+		}
+
+		pieces.push_back(piece);
+	}
+
+	// Count the vertices of every piece. Vertices shared between pieces of a
+	// subset are copied into each, as their blend indices differ.
+	ULONG* seen = arena.NewArray<ULONG>(mesh.VertexCount);
+	ULONG* slot = arena.NewArray<ULONG>(mesh.VertexCount);
+	if (!seen || !slot)
+	{
+		return false;
+	}
+	for (ULONG i = 0; i < mesh.VertexCount; i++)
+	{
+		seen[i] = 0;
+	}
+
+	ULONG vertexCount = 0;
+	for (size_t p = 0; p < pieces.size(); p++)
+	{
+		PalettePiece& piece = pieces[p];
+		piece.VertexCount = 0;
+		for (ULONG i = piece.TriangleStart; i < piece.TriangleStart + piece.TriangleCount; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				ULONG v = mesh.Indices[order[i] * 3 + k];
+				if (seen[v] != p + 1)
+				{
+					seen[v] = (ULONG)(p + 1);
+					piece.VertexCount++;
+				}
+			}
+		}
+		vertexCount += piece.VertexCount;
+	}
+
+	UINT newObjects = objects + extra;
+	vertexData* vertices = arena.NewArray<vertexData>(vertexCount);
+	SkinVertex* skin = arena.NewArray<SkinVertex>(vertexCount);
+	ULONG* indices = arena.NewArray<ULONG>(triangleCount * 3);
+	ULONG* pieceVertices = arena.NewArray<ULONG>(vertexCount);
+	SubsetTableDesc* subsets = arena.NewArray<SubsetTableDesc>(newObjects);
+	MatrialDesc* materials = arena.NewArray<MatrialDesc>(newObjects);
+	UINT* textureSize = arena.NewArray<UINT>(newObjects);
+	const char** textureName = arena.NewArray<const char*>(newObjects);
+	BonePaletteDesc* palettes = arena.NewArray<BonePaletteDesc>(newObjects);
+	UINT* paletteBones = arena.NewArray<UINT>(bones.size() + 1);
+	if (!vertices || !skin || !indices || !pieceVertices || !subsets || !materials || !textureSize || !textureName || !palettes || !paletteBones)
+	{
+		return false;
+	}
+
+	// Emit the pieces one after the other. A piece keeps its vertices in
+	// mesh order, so a subset that fits one palette comes out as it went in.
+	for (ULONG i = 0; i < mesh.VertexCount; i++)
+	{
+		seen[i] = 0;
+	}
+
+	ULONG vertexOffset = 0, triangleOffset = 0;
+	for (size_t p = 0; p < pieces.size(); p++)
+	{
+		const PalettePiece& piece = pieces[p];
+		UINT id = piece.NewSubset;
+
+		ULONG count = 0;
+		for (ULONG i = piece.TriangleStart; i < piece.TriangleStart + piece.TriangleCount; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				ULONG v = mesh.Indices[order[i] * 3 + k];
+				if (seen[v] != p + 1)
+				{
+					seen[v] = (ULONG)(p + 1);
+					pieceVertices[count++] = v;
+				}
+			}
+		}
+		sort(pieceVertices, pieceVertices + count);
+
+		for (UINT b = 0; b < piece.BoneCount; b++)
+		{
+			localOf[bones[piece.BoneStart + b]] = b;
+		}
+
+		for (ULONG i = 0; i < count; i++)
+		{
+			ULONG v = pieceVertices[i];
+			slot[v] = vertexOffset + i;
+
+			vertices[vertexOffset + i] = mesh.Vertices[v];
+			vertices[vertexOffset + i].ID = id;
+
+			SkinVertex& out = skin[vertexOffset + i];
+			out = mesh.Skin[v];
+			for (int k = 0; k < 4; k++)
+			{
+				out.BlendIndices[k] = (&out.BlendWeights.x)[k] != 0.0f ? (unsigned char)localOf[out.BlendIndices[k]] : 0;
+			}
+		}
+
+		for (ULONG i = 0; i < piece.TriangleCount; i++)
+		{
+			const ULONG* index = mesh.Indices + order[piece.TriangleStart + i] * 3;
+			ULONG* out = indices + (triangleOffset + i) * 3;
+			out[0] = slot[index[0]];
+			out[1] = slot[index[1]];
+			out[2] = slot[index[2]];
+		}
+
+		subsets[id].SubsetID = id;
+		subsets[id].VertexStart = vertexOffset;
+		subsets[id].VertexCount = count;
+		subsets[id].FaceStart = triangleOffset;
+		subsets[id].FaceCount = piece.TriangleCount;
+		materials[id] = mesh.Materials[piece.Subset];
+		textureSize[id] = mesh.TextureSize[piece.Subset];
+		textureName[id] = mesh.TextureName[piece.Subset];
+		palettes[id].Start = piece.BoneStart;
+		palettes[id].Count = piece.BoneCount;
+
+		vertexOffset += count;
+		triangleOffset += piece.TriangleCount;
+	}
+
+	for (size_t i = 0; i < bones.size(); i++)
+	{
+		paletteBones[i] = bones[i];
+	}
+
+	mesh.VertexCount = vertexCount;
+	mesh.IndexCount = triangleCount * 3;
+	mesh.ObjectCount = newObjects;
+	mesh.Vertices = vertices;
+	mesh.Indices = indices;
+	mesh.Subsets = subsets;
+	mesh.Materials = materials;
+	mesh.TextureSize = textureSize;
+	mesh.TextureName = textureName;
+	mesh.Skin = skin;
+	mesh.Palettes = palettes;
+	mesh.PaletteBones = paletteBones;
+	mesh.PaletteBoneCount = (UINT)bones.size();
+
+	return true;
+}
@@ -0,0 +1,237 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Stats.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <chrono>
+#include <cstdio>
+#include "Stats.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+using namespace std;
+
+
+StageTimer::StageTimer(ConversionStats* stats, StatStage stage, const Arena& arena) : m_arena(arena)
+{
+	m_stats = stats;
+	m_stage = stage;
+	m_start = stats ? StatsClock() : 0.0;
+	m_allocations = arena.AllocationCount();
+	m_heapBlocks = arena.BlockAllocations();
+}
+
+
+StageTimer::~StageTimer()
+{
+	Stop(0);
+}
+
+
+void StageTimer::Stop(unsigned long long bytes)
+{
+	if (!m_stats)
+	{
+		return;
+	}
+
+	StageStats& stage = m_stats->Stages[m_stage];
+	stage.Calls++;
+	stage.Seconds += StatsClock() - m_start;
+	stage.Bytes += bytes;
+	stage.Allocations += m_arena.AllocationCount() - m_allocations;
+	stage.HeapBlocks += m_arena.BlockAllocations() - m_heapBlocks;
+	stage.PeakRSS = PeakRSS();
+
+	// Only the first stop counts.
+	m_stats = 0;
+}
+
+
+void ResetStats(ConversionStats& stats, const string& file)
+{
+	stats.File = file;
+	stats.Succeeded = true;
+	stats.Files = 0;
+	for (int i = 0; i < STAGE_MAX; i++)
+	{
+		stats.Stages[i].Calls = 0;
+		stats.Stages[i].Seconds = 0.0;
+		stats.Stages[i].Bytes = 0;
+		stats.Stages[i].Allocations = 0;
+		stats.Stages[i].HeapBlocks = 0;
+		stats.Stages[i].PeakRSS = 0;
+	}
+	stats.Validation.BadIndices = 0;
+	stats.Validation.NonFiniteVertices = 0;
+	stats.Validation.DegenerateTriangles = 0;
+	stats.Validation.DroppedTriangles = 0;
+	stats.Validation.ImpossibleCounts = 0;
+}
+
+
+void AccumulateStats(ConversionStats& total, const ConversionStats& stats)
+{
+	total.Files++;
+	total.Succeeded = total.Succeeded && stats.Succeeded;
+	for (int i = 0; i < STAGE_MAX; i++)
+	{
+		total.Stages[i].Calls += stats.Stages[i].Calls;
+		total.Stages[i].Seconds += stats.Stages[i].Seconds;
+		total.Stages[i].Bytes += stats.Stages[i].Bytes;
+		total.Stages[i].Allocations += stats.Stages[i].Allocations;
+		total.Stages[i].HeapBlocks += stats.Stages[i].HeapBlocks;
+		if (stats.Stages[i].PeakRSS > total.Stages[i].PeakRSS)
+		{
+			total.Stages[i].PeakRSS = stats.Stages[i].PeakRSS;
+		}
+	}
+	total.Validation.BadIndices += stats.Validation.BadIndices;
+	total.Validation.NonFiniteVertices += stats.Validation.NonFiniteVertices;
+	total.Validation.DegenerateTriangles += stats.Validation.DegenerateTriangles;
+	total.Validation.DroppedTriangles += stats.Validation.DroppedTriangles;
+	total.Validation.ImpossibleCounts += stats.Validation.ImpossibleCounts;
+}
+
+
+string JsonEscape(const string& text)
+{
+	// Paths carry backslashes on Windows and may carry anything else.
+	string out;
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		unsigned char c = (unsigned char)text[i];
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += (char)c;
+		}
+		else if (c < 0x20)
+		{
+			char code[8];
+			snprintf(code, sizeof(code), "\\u%04x", c);
+			out += code;
+		}
+		else
+		{
+			out += (char)c;
+		}
+	}
+	return out;
+}
+
+
+void WriteStatsJSON(ostream& out, const ConversionStats& stats)
+{
+	char number[64];
+	double seconds = 0.0;
+	bool first = true;
+
+	out << "{\"file\": \"" << JsonEscape(stats.File);
+	out << "\", \"succeeded\": " << (stats.Succeeded ? "true" : "false");
+	if (stats.Files)
+	{
+		out << ", \"files\": " << stats.Files;
+	}
+	out << ", \"stages\": {";
+
+	for (int i = 0; i < STAGE_MAX; i++)
+	{
+		const StageStats& stage = stats.Stages[i];
+		if (!stage.Calls)
+		{
+			continue;
+		}
+		seconds += stage.Seconds;
+
+		snprintf(number, sizeof(number), "%.6f", stage.Seconds);
+		out << (first ? "" : ", ") << "\"" << StageName((StatStage)i) << "\": {";
+		out << "\"calls\": " << stage.Calls;
+		out << ", \"seconds\": " << number;
+		out << ", \"bytes\": " << stage.Bytes;
+		out << ", \"allocations\": " << stage.Allocations;
+		out << ", \"heap_blocks\": " << stage.HeapBlocks;
+		out << ", \"peak_rss_bytes\": " << stage.PeakRSS << "}";
+		first = false;
+	}
+
+	out << "}";
+
+	if (stats.Stages[STAGE_VALIDATE].Calls || stats.Validation.ImpossibleCounts)
+	{
+		out << ", \"validation\": {\"bad_indices\": " << stats.Validation.BadIndices;
+		out << ", \"non_finite_vertices\": " << stats.Validation.NonFiniteVertices;
+		out << ", \"degenerate_triangles\": " << stats.Validation.DegenerateTriangles;
+		out << ", \"dropped_triangles\": " << stats.Validation.DroppedTriangles;
+		out << ", \"impossible_counts\": " << stats.Validation.ImpossibleCounts << "}";
+	}
+
+	snprintf(number, sizeof(number), "%.6f", seconds);
+	out << ", \"seconds\": " << number << "}";
+}
+
+
+const char* StageName(StatStage stage)
+{
+	switch (stage)
+	{
+	case STAGE_OPEN: return "open";
+	case STAGE_COUNT: return "count";
+	case STAGE_PARSE: return "parse";
+	case STAGE_NORMALS: return "normals";
+	case STAGE_EXPAND: return "expand";
+	case STAGE_M3D_HEADER: return "m3d_header";
+	case STAGE_M3D_MATERIALS: return "m3d_materials";
+	case STAGE_M3D_SUBSETS: return "m3d_subsets";
+	case STAGE_M3D_VERTICES: return "m3d_vertices";
+	case STAGE_M3D_TRIANGLES: return "m3d_triangles";
+	case STAGE_VALIDATE: return "validate";
+	case STAGE_CONVERT: return "convert";
+	case STAGE_PALETTE: return "palette";
+	case STAGE_INSTANCE: return "instance";
+	case STAGE_COLLISION: return "collision";
+	case STAGE_SMF_WRITE: return "smf_write";
+	default: return "unknown";
+	}
+}
+
+
+unsigned long long PeakRSS()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+#ifdef __APPLE__
+		return (unsigned long long)usage.ru_maxrss;
+#else
+		// Linux reports kilobytes.
+		return (unsigned long long)usage.ru_maxrss * 1024;
+#endif
+	}
+	return 0;
+#endif
+}
+
+
+double StatsClock()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
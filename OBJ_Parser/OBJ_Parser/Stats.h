@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Stats.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _STATS_H_
+#define _STATS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <ostream>
+#include <string>
+#include "Arena.h"
+
+
+//////////////
+// TYPEDEFS //
+//////////////
+enum StatStage
+{
+	STAGE_OPEN,
+	STAGE_COUNT,
+	STAGE_PARSE,
+	STAGE_NORMALS,
+	STAGE_EXPAND,
+	STAGE_M3D_HEADER,
+	STAGE_M3D_MATERIALS,
+	STAGE_M3D_SUBSETS,
+	STAGE_M3D_VERTICES,
+	STAGE_M3D_TRIANGLES,
+	STAGE_VALIDATE,
+	STAGE_CONVERT,
+	STAGE_PALETTE,
+	STAGE_INSTANCE,
+	STAGE_COLLISION,
+	STAGE_SMF_WRITE,
+	STAGE_MAX
+};
+
+struct StageStats
+{
+	unsigned long long Calls;
+	double Seconds;
+	unsigned long long Bytes;
+	unsigned long long Allocations;
+	unsigned long long HeapBlocks;
+	unsigned long long PeakRSS;
+};
+
+// What the validation stage found in a model. BadIndices counts faces and
+// triangles naming an element the file does not have; every one of them, and
+// every triangle touching a NaN or infinite vertex or without area, is dropped.
+// ImpossibleCounts counts headers whose counts the file is too short to hold;
+// such a file is rejected before anything is allocated for it.
+struct ValidationStats
+{
+	unsigned long long BadIndices;
+	unsigned long long NonFiniteVertices;
+	unsigned long long DegenerateTriangles;
+	unsigned long long DroppedTriangles;
+	unsigned long long ImpossibleCounts;
+};
+
+struct ConversionStats
+{
+	std::string File;
+	bool Succeeded;
+	unsigned long long Files;
+	StageStats Stages[STAGE_MAX];
+	ValidationStats Validation;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: StageTimer
+// Measures one stage from construction until Stop() or destruction and adds
+// the result to the stage's totals. A null stats pointer disables it.
+////////////////////////////////////////////////////////////////////////////////
+class StageTimer
+{
+public:
+	StageTimer(ConversionStats* stats, StatStage stage, const Arena& arena);
+	~StageTimer();
+
+	void Stop(unsigned long long bytes);
+
+private:
+	StageTimer(const StageTimer&);
+	StageTimer& operator=(const StageTimer&);
+
+private:
+	ConversionStats* m_stats;
+	StatStage m_stage;
+	const Arena& m_arena;
+	double m_start;
+	size_t m_allocations;
+	size_t m_heapBlocks;
+};
+
+
+/////////////////////////
+// FUNCTION PROTOTYPES //
+/////////////////////////
+void ResetStats(ConversionStats& stats, const std::string& file);
+void AccumulateStats(ConversionStats& total, const ConversionStats& stats);
+void WriteStatsJSON(std::ostream& out, const ConversionStats& stats);
+std::string JsonEscape(const std::string& text);
+const char* StageName(StatStage stage);
+unsigned long long PeakRSS();
+double StatsClock();
+
+#endif
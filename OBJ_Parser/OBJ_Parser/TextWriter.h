@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TextWriter.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _TEXTWRITER_H_
+#define _TEXTWRITER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#if defined(__has_include)
+#if __has_include(<charconv>) && __cplusplus >= 201703L
+#include <charconv>
+#define TEXTWRITER_TO_CHARS
+#endif
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TextWriter
+// Buffered text output for large dumps. Numbers are formatted straight into
+// the buffer and the buffer only goes to the file when it is full, so dumping
+// millions of values is not bound by per-line flushes like cout << endl.
+////////////////////////////////////////////////////////////////////////////////
+class TextWriter
+{
+public:
+	TextWriter(FILE* file)
+	{
+		m_file = file;
+		m_used = 0;
+	}
+
+	~TextWriter()
+	{
+		Flush();
+	}
+
+	void Flush()
+	{
+		Drain();
+		fflush(m_file);
+	}
+
+	TextWriter& Write(const char* str, size_t length)
+	{
+		if (length > sizeof(m_buffer) - m_used)
+		{
+			Drain();
+			if (length > sizeof(m_buffer))
+			{
+				fwrite(str, 1, length, m_file);
+				return *this;
+			}
+		}
+
+		memcpy(m_buffer + m_used, str, length);
+		m_used += length;
+		return *this;
+	}
+
+	TextWriter& operator<<(const char* str) { return Write(str, strlen(str)); }
+	TextWriter& operator<<(const std::string& str) { return Write(str.c_str(), str.size()); }
+	TextWriter& operator<<(char c) { return Write(&c, 1); }
+
+	TextWriter& operator<<(unsigned long long value)
+	{
+		char digits[24];
+		int count = 0;
+		do
+		{
+			digits[sizeof(digits) - 1 - count++] = (char)('0' + value % 10);
+			value /= 10;
+		} while (value);
+
+		return Write(digits + sizeof(digits) - count, count);
+	}
+
+	TextWriter& operator<<(long long value)
+	{
+		if (value < 0)
+		{
+			Write("-", 1);
+			return *this << (unsigned long long)(-(value + 1)) + 1;
+		}
+		return *this << (unsigned long long)value;
+	}
+
+	TextWriter& operator<<(unsigned int value) { return *this << (unsigned long long)value; }
+	TextWriter& operator<<(unsigned long value) { return *this << (unsigned long long)value; }
+	TextWriter& operator<<(int value) { return *this << (long long)value; }
+	TextWriter& operator<<(long value) { return *this << (long long)value; }
+
+	// Shortest text that reads back as the same float.
+	TextWriter& operator<<(float value)
+	{
+		char text[32];
+#ifdef TEXTWRITER_TO_CHARS
+		std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+		return Write(text, result.ptr - text);
+#else
+		int length = snprintf(text, sizeof(text), "%.9g", value);
+		return Write(text, length > 0 ? length : 0);
+#endif
+	}
+
+	TextWriter& operator<<(double value)
+	{
+		char text[40];
+#ifdef TEXTWRITER_TO_CHARS
+		std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+		return Write(text, result.ptr - text);
+#else
+		int length = snprintf(text, sizeof(text), "%.17g", value);
+		return Write(text, length > 0 ? length : 0);
+#endif
+	}
+
+private:
+	TextWriter(const TextWriter&);
+	TextWriter& operator=(const TextWriter&);
+
+	// Writes the buffer without flushing the file.
+	void Drain()
+	{
+		if (m_used)
+		{
+			fwrite(m_buffer, 1, m_used, m_file);
+			m_used = 0;
+		}
+	}
+
+private:
+	FILE* m_file;
+	size_t m_used;
+	char m_buffer[1 << 16];
+};
+
+#endif
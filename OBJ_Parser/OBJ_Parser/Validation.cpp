@@ -0,0 +1,266 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Validation.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <atomic>
+#include <cstring>
+#include "ModelParser.h"
+#include "Parallel.h"
+#include "Simd.h"
+using namespace std;
+
+
+// Vertices or triangles per thread below which threads cost more than they save.
+static const size_t VALIDATE_GRAIN = 64 * 1024;
+
+// The exponent bits of a float, all set for NaN and the infinities.
+static const UINT FLOAT_EXPONENT = 0x7f800000;
+
+// Largest squared sine of the angle between two edges of a triangle that
+// still has no area to speak of, an angle of about 1e-5 radians. Well above
+// the rounding of the cross product in floats.
+static const float SLIVER_SINE2 = 1e-10f;
+
+
+#ifdef MODEL_SSE2
+
+// The position, texture coordinate and normal of a vertex are its first eight
+// floats, so two loads test all of them at once.
+static bool FiniteVertex(const vertexData& v)
+{
+	const __m128i exponent = _mm_set1_epi32((int)FLOAT_EXPONENT);
+	__m128i a = _mm_loadu_si128((const __m128i*)&v.pos.x);
+	__m128i b = _mm_loadu_si128((const __m128i*)&v.tex.y);
+	__m128i bad = _mm_or_si128(
+		_mm_cmpeq_epi32(_mm_and_si128(a, exponent), exponent),
+		_mm_cmpeq_epi32(_mm_and_si128(b, exponent), exponent));
+	return _mm_movemask_epi8(bad) == 0;
+}
+
+
+// A bit per triangle of the four starting at indices that names a vertex past
+// count. SSE2 only compares signed, so both sides are moved by the sign bit.
+static int OutOfRange4(const ULONG* indices, ULONG count)
+{
+	const __m128i bias = _mm_set1_epi32((int)0x80000000);
+	const __m128i limit = _mm_set1_epi32((int)(count ^ 0x80000000));
+	int mask = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		__m128i i = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(indices + k * 4)), bias);
+		__m128i bad = _mm_or_si128(_mm_cmpgt_epi32(i, limit), _mm_cmpeq_epi32(i, limit));
+		mask |= _mm_movemask_ps(_mm_castsi128_ps(bad)) << (k * 4);
+	}
+
+	// Lane j of the twelve belongs to triangle j / 3.
+	int triangles = 0;
+	for (int t = 0; t < 4; t++)
+	{
+		if (mask & (7 << (t * 3)))
+		{
+			triangles |= 1 << t;
+		}
+	}
+	return triangles;
+}
+
+
+// The sum of the first three lanes.
+static float Sum3(__m128 v)
+{
+	__m128 yz = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 2, 1));
+	return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(v, yz), _mm_shuffle_ps(yz, yz, _MM_SHUFFLE(3, 3, 3, 1))));
+}
+
+
+// A triangle has no area to speak of when its cross product is tiny next to
+// its edges, |e1 x e2|^2 = |e1|^2 |e2|^2 sin^2, whatever the coordinates' scale.
+// The fourth lane of each load is tex.x, which the masks keep out.
+static bool ZeroArea(const vertexData& a, const vertexData& b, const vertexData& c)
+{
+	const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	__m128 p = _mm_loadu_ps(&a.pos.x);
+	__m128 e1 = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(&b.pos.x), p), xyz);
+	__m128 e2 = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(&c.pos.x), p), xyz);
+	__m128 cross = _mm_sub_ps(
+		_mm_mul_ps(_mm_shuffle_ps(e1, e1, _MM_SHUFFLE(3, 0, 2, 1)), _mm_shuffle_ps(e2, e2, _MM_SHUFFLE(3, 1, 0, 2))),
+		_mm_mul_ps(_mm_shuffle_ps(e1, e1, _MM_SHUFFLE(3, 1, 0, 2)), _mm_shuffle_ps(e2, e2, _MM_SHUFFLE(3, 0, 2, 1))));
+	return Sum3(_mm_mul_ps(cross, cross)) <= SLIVER_SINE2 * Sum3(_mm_mul_ps(e1, e1)) * Sum3(_mm_mul_ps(e2, e2));
+}
+
+#else
+
+static bool FiniteVertex(const vertexData& v)
+{
+	const float* f = &v.pos.x;
+	for (int k = 0; k < 8; k++)
+	{
+		UINT bits;
+		memcpy(&bits, &f[k], sizeof(bits));
+		if ((bits & FLOAT_EXPONENT) == FLOAT_EXPONENT)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static int OutOfRange4(const ULONG* indices, ULONG count)
+{
+	int triangles = 0;
+	for (int t = 0; t < 4; t++)
+	{
+		if (indices[t * 3] >= count || indices[t * 3 + 1] >= count || indices[t * 3 + 2] >= count)
+		{
+			triangles |= 1 << t;
+		}
+	}
+	return triangles;
+}
+
+
+static bool ZeroArea(const vertexData& a, const vertexData& b, const vertexData& c)
+{
+	float e1x = b.pos.x - a.pos.x, e1y = b.pos.y - a.pos.y, e1z = b.pos.z - a.pos.z;
+	float e2x = c.pos.x - a.pos.x, e2y = c.pos.y - a.pos.y, e2z = c.pos.z - a.pos.z;
+	float cx = e1y * e2z - e1z * e2y, cy = e1z * e2x - e1x * e2z, cz = e1x * e2y - e1y * e2x;
+	return cx * cx + cy * cy + cz * cz <= SLIVER_SINE2 * (e1x * e1x + e1y * e1y + e1z * e1z) * (e2x * e2x + e2y * e2y + e2z * e2z);
+}
+
+#endif
+
+
+// Flags the triangles in [begin, end) worth keeping, counting those that name
+// a vertex past the end and those that have no area or repeat a corner.
+static void CheckTriangles(const Mesh& mesh, const unsigned char* finite, size_t begin, size_t end, unsigned char* keep,
+	unsigned long long& badIndices, unsigned long long& degenerate)
+{
+	const ULONG* indices = mesh.Indices;
+	const vertexData* vertices = mesh.Vertices;
+	ULONG count = mesh.VertexCount;
+
+	for (size_t t = begin; t < end; )
+	{
+		// Four triangles have their bounds checked together where they can be.
+		int outside;
+		size_t block = end - t < 4 ? 1 : 4;
+		if (block == 4)
+		{
+			outside = OutOfRange4(indices + t * 3, count);
+		}
+		else
+		{
+			const ULONG* i = indices + t * 3;
+			outside = i[0] >= count || i[1] >= count || i[2] >= count;
+		}
+
+		for (size_t j = 0; j < block; j++, t++)
+		{
+			const ULONG* i = indices + t * 3;
+			keep[t] = 0;
+			if (outside & (1 << j))
+			{
+				badIndices++;
+			}
+			else if (!finite[i[0]] || !finite[i[1]] || !finite[i[2]])
+			{
+				// Counted with the vertices.
+			}
+			else if (i[0] == i[1] || i[1] == i[2] || i[0] == i[2] || ZeroArea(vertices[i[0]], vertices[i[1]], vertices[i[2]]))
+			{
+				degenerate++;
+			}
+			else
+			{
+				keep[t] = 1;
+			}
+		}
+	}
+}
+
+
+bool SanitizeMesh(Mesh& mesh, Arena& arena, ValidationStats* validation)
+{
+	size_t vertexCount = mesh.VertexCount;
+	size_t triangleCount = mesh.IndexCount / 3;
+
+	unsigned char* finite = arena.NewArray<unsigned char>(vertexCount);
+	unsigned char* keep = arena.NewArray<unsigned char>(triangleCount);
+	if (!finite || !keep)
+	{
+		return false;
+	}
+
+	// Every range adds its counts once, so the threads barely touch the totals.
+	atomic<unsigned long long> nonFinite(0), badIndices(0), degenerate(0);
+
+	const vertexData* vertices = mesh.Vertices;
+	ParallelFor(vertexCount, VALIDATE_GRAIN, [&](size_t begin, size_t end) {
+		unsigned long long bad = 0;
+		for (size_t v = begin; v < end; v++)
+		{
+			finite[v] = FiniteVertex(vertices[v]);
+			bad += !finite[v];
+		}
+		nonFinite += bad;
+	});
+
+	ParallelFor(triangleCount, VALIDATE_GRAIN, [&](size_t begin, size_t end) {
+		unsigned long long outside = 0, flat = 0;
+		CheckTriangles(mesh, finite, begin, end, keep, outside, flat);
+		badIndices += outside;
+		degenerate += flat;
+	});
+
+	// Dropping triangles keeps the rest in order and the vertices where they
+	// are, so only the indices and the subsets' face ranges move.
+	ULONG* kept = arena.NewArray<ULONG>(triangleCount + 1);
+	if (!kept)
+	{
+		return false;
+	}
+
+	ULONG* indices = mesh.Indices;
+	ULONG written = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		kept[t] = written;
+		if (keep[t])
+		{
+			indices[written * 3] = indices[t * 3];
+			indices[written * 3 + 1] = indices[t * 3 + 1];
+			indices[written * 3 + 2] = indices[t * 3 + 2];
+			written++;
+		}
+	}
+	kept[triangleCount] = written;
+
+	if (mesh.Subsets && written != triangleCount)
+	{
+		for (UINT i = 0; i < mesh.ObjectCount; i++)
+		{
+			SubsetTableDesc& subset = mesh.Subsets[i];
+			size_t first = subset.FaceStart < triangleCount ? subset.FaceStart : triangleCount;
+			size_t last = subset.FaceCount < triangleCount - first ? first + subset.FaceCount : triangleCount;
+			subset.FaceStart = kept[first];
+			subset.FaceCount = kept[last] - kept[first];
+		}
+	}
+
+	mesh.IndexCount = written * 3;
+
+	if (validation)
+	{
+		validation->BadIndices += badIndices;
+		validation->NonFiniteVertices += nonFinite;
+		validation->DegenerateTriangles += degenerate;
+		validation->DroppedTriangles += triangleCount - written;
+	}
+
+	return true;
+}
@@ -0,0 +1,492 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Watch.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <iostream>
+#include "Watch.h"
+
+#ifdef __linux__
+#include <csignal>
+#include <cstring>
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+
+WatchServer::WatchServer()
+{
+	m_inotify = -1;
+	m_listen = -1;
+	m_debounce = 0;
+	m_quit = false;
+}
+
+
+#ifdef __linux__
+
+// Set by SIGINT and SIGTERM so Run() can close the socket on the way out.
+static volatile sig_atomic_t g_WatchInterrupted = 0;
+
+static void OnWatchSignal(int)
+{
+	g_WatchInterrupted = 1;
+}
+
+
+// Only files a conversion reads are worth waking up for.
+static bool IsWatchedFile(const string& name)
+{
+	string::size_type dot = name.rfind('.');
+	if (dot == string::npos)
+	{
+		return false;
+	}
+
+	string extension = name.substr(dot + 1);
+	return extension == "obj" || extension == "m3d" || extension == "mtl";
+}
+
+
+static bool SendLine(int socket, const string& line)
+{
+	string message = line + "\n";
+	size_t sent = 0;
+	while (sent < message.size())
+	{
+		ssize_t count = send(socket, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count <= 0)
+		{
+			return false;
+		}
+		sent += (size_t)count;
+	}
+
+	return true;
+}
+
+
+WatchServer::~WatchServer()
+{
+	for (size_t i = 0; i < m_clients.size(); i++)
+	{
+		close(m_clients[i].Socket);
+	}
+	if (m_listen >= 0)
+	{
+		close(m_listen);
+		unlink(m_socketPath.c_str());
+	}
+	if (m_inotify >= 0)
+	{
+		close(m_inotify);
+	}
+}
+
+
+bool WatchServer::AddDirectory(const char* path)
+{
+	if (m_inotify < 0)
+	{
+		m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_inotify < 0)
+		{
+			return false;
+		}
+	}
+
+	// Paths are joined with a slash, so the cache keys of material libraries
+	// come out the way the parser spells them.
+	string directory(path);
+	while (directory.size() > 1 && directory[directory.size() - 1] == '/')
+	{
+		directory.erase(directory.size() - 1);
+	}
+
+	return WatchTree(directory);
+}
+
+
+bool WatchServer::WatchTree(const string& path)
+{
+	// Saves are finished writes or temporary files renamed into place.
+	int watch = inotify_add_watch(m_inotify, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+	if (watch < 0)
+	{
+		return false;
+	}
+	m_directories[watch] = path;
+
+	DIR* dir = opendir(path.c_str());
+	if (!dir)
+	{
+		return false;
+	}
+
+	bool result = true;
+	while (dirent* entry = readdir(dir))
+	{
+		if (entry->d_name[0] == '.')
+		{
+			continue;
+		}
+
+		// inotify_add_watch() with IN_ONLYDIR tells directories apart where
+		// d_type is not filled in.
+		if (entry->d_type == DT_DIR || entry->d_type == DT_UNKNOWN)
+		{
+			string child = path + "/" + entry->d_name;
+			if (!WatchTree(child) && entry->d_type == DT_DIR)
+			{
+				result = false;
+			}
+		}
+	}
+	closedir(dir);
+
+	return result;
+}
+
+
+bool WatchServer::Listen(const char* path)
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (m_listen >= 0 || strlen(path) >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	strcpy(address.sun_path, path);
+
+	m_listen = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (m_listen < 0)
+	{
+		return false;
+	}
+
+	// A socket file nobody answers on is left over from an earlier run.
+	if (connect(m_listen, (sockaddr*)&address, sizeof(address)) == 0)
+	{
+		close(m_listen);
+		m_listen = -1;
+		return false;
+	}
+	unlink(path);
+
+	close(m_listen);
+	m_listen = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (m_listen < 0 || bind(m_listen, (sockaddr*)&address, sizeof(address)) != 0 || listen(m_listen, 8) != 0)
+	{
+		if (m_listen >= 0)
+		{
+			close(m_listen);
+			m_listen = -1;
+		}
+		return false;
+	}
+	m_socketPath = path;
+
+	return true;
+}
+
+
+bool WatchServer::Run(WatchCallback callback, void* user, unsigned int debounceMs)
+{
+	if (m_inotify < 0 && m_listen < 0)
+	{
+		return false;
+	}
+
+	m_debounce = debounceMs;
+	m_quit = false;
+	g_WatchInterrupted = 0;
+	signal(SIGINT, OnWatchSignal);
+	signal(SIGTERM, OnWatchSignal);
+
+	bool result = true;
+	while (!m_quit && !g_WatchInterrupted)
+	{
+		// The inotify and listening sockets come first, then the clients.
+		vector<pollfd> fds;
+		pollfd fd;
+		fd.events = POLLIN;
+		fd.revents = 0;
+		fd.fd = m_inotify;
+		fds.push_back(fd);
+		fd.fd = m_listen;
+		fds.push_back(fd);
+		for (size_t i = 0; i < m_clients.size(); i++)
+		{
+			fd.fd = m_clients[i].Socket;
+			fds.push_back(fd);
+		}
+
+		int ready = poll(&fds[0], fds.size(), Timeout());
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			result = false;
+			break;
+		}
+
+		if (fds[0].revents & POLLIN)
+		{
+			ReadEvents();
+		}
+		if (fds[1].revents & POLLIN)
+		{
+			AcceptClient();
+		}
+
+		// Clients that hung up or sent "quit" are dropped.
+		size_t kept = 0;
+		for (size_t i = 0; i < m_clients.size(); i++)
+		{
+			bool open = true;
+			if (fds[2 + i].revents & (POLLIN | POLLHUP | POLLERR))
+			{
+				open = ReadClient(m_clients[i], callback, user);
+			}
+
+			if (open)
+			{
+				m_clients[kept++] = m_clients[i];
+			}
+			else
+			{
+				close(m_clients[i].Socket);
+			}
+		}
+		m_clients.resize(kept);
+
+		ConvertDue(callback, user);
+	}
+
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+
+	return result;
+}
+
+
+void WatchServer::ReadEvents()
+{
+	alignas(inotify_event) char buffer[4096];
+
+	for (;;)
+	{
+		ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+		if (length <= 0)
+		{
+			return;
+		}
+
+		for (ssize_t offset = 0; offset < length; )
+		{
+			const inotify_event* event = (const inotify_event*)(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				cout << "Watch events were lost, save the files again to convert them." << endl;
+				continue;
+			}
+			if (event->mask & IN_IGNORED)
+			{
+				m_directories.erase(event->wd);
+				continue;
+			}
+
+			map<int, string>::const_iterator directory = m_directories.find(event->wd);
+			if (directory == m_directories.end() || event->len == 0)
+			{
+				continue;
+			}
+
+			string path = directory->second + "/" + event->name;
+			if (event->mask & IN_ISDIR)
+			{
+				if (event->mask & (IN_CREATE | IN_MOVED_TO))
+				{
+					WatchTree(path);
+				}
+			}
+			else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && IsWatchedFile(event->name))
+			{
+				// Every further save pushes the conversion back, so an editor
+				// writing a file in pieces is converted once.
+				m_due[path] = Clock::now() + chrono::milliseconds(m_debounce);
+			}
+		}
+	}
+}
+
+
+void WatchServer::AcceptClient()
+{
+	int socket = accept4(m_listen, 0, 0, SOCK_CLOEXEC);
+	if (socket < 0)
+	{
+		return;
+	}
+
+	Client client;
+	client.Socket = socket;
+	m_clients.push_back(client);
+}
+
+
+bool WatchServer::ReadClient(Client& client, WatchCallback callback, void* user)
+{
+	char buffer[1024];
+	ssize_t length = recv(client.Socket, buffer, sizeof(buffer), 0);
+	if (length <= 0)
+	{
+		return length < 0 && errno == EINTR;
+	}
+	client.Received.append(buffer, (size_t)length);
+
+	// A request is a whole line. Anything longer than a path can be is noise.
+	string::size_type end;
+	while ((end = client.Received.find('\n')) != string::npos)
+	{
+		string line = client.Received.substr(0, end);
+		client.Received.erase(0, end + 1);
+		if (!line.empty() && line[line.size() - 1] == '\r')
+		{
+			line.erase(line.size() - 1);
+		}
+
+		if (line == "quit")
+		{
+			SendLine(client.Socket, "ok");
+			m_quit = true;
+			return false;
+		}
+
+		if (line.compare(0, 8, "convert ") != 0)
+		{
+			if (!SendLine(client.Socket, "error unknown request"))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		string source = line.substr(8);
+		string output;
+		vector<string> stale;
+		bool converted = callback(source, output, stale, user);
+
+		// A save waiting for its debounce has just been converted.
+		m_due.erase(source);
+		Queue(stale);
+
+		if (!SendLine(client.Socket, !converted ? "error " + source : output.empty() ? "ok" : "ok " + output))
+		{
+			return false;
+		}
+	}
+
+	return client.Received.size() <= 4096;
+}
+
+
+void WatchServer::ConvertDue(WatchCallback callback, void* user)
+{
+	Clock::time_point now = Clock::now();
+
+	map<string, Clock::time_point>::iterator it = m_due.begin();
+	while (it != m_due.end())
+	{
+		if (it->second > now)
+		{
+			++it;
+			continue;
+		}
+
+		string source = it->first;
+		m_due.erase(it++);
+
+		string output;
+		vector<string> stale;
+		if (!callback(source, output, stale, user))
+		{
+			cout << "File " << source << " could not be converted." << endl;
+		}
+		Queue(stale);
+	}
+}
+
+
+void WatchServer::Queue(const vector<string>& paths)
+{
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		m_due[paths[i]] = Clock::now() + chrono::milliseconds(m_debounce);
+	}
+}
+
+
+int WatchServer::Timeout() const
+{
+	if (m_due.empty())
+	{
+		return -1;
+	}
+
+	Clock::time_point next = m_due.begin()->second;
+	for (map<string, Clock::time_point>::const_iterator it = m_due.begin(); it != m_due.end(); ++it)
+	{
+		if (it->second < next)
+		{
+			next = it->second;
+		}
+	}
+
+	chrono::milliseconds wait = chrono::duration_cast<chrono::milliseconds>(next - Clock::now());
+	return wait.count() > 0 ? (int)wait.count() + 1 : 0;
+}
+
+#else
+
+WatchServer::~WatchServer()
+{
+}
+
+
+bool WatchServer::AddDirectory(const char*)
+{
+	return false;
+}
+
+
+bool WatchServer::Listen(const char*)
+{
+	return false;
+}
+
+
+bool WatchServer::Run(WatchCallback, void*, unsigned int)
+{
+	return false;
+}
+
+#endif
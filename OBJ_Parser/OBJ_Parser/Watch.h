@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Watch.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _WATCH_H_
+#define _WATCH_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+
+//////////////
+// TYPEDEFS //
+//////////////
+
+// Converts one saved or requested file. output is set to the file written, or
+// left empty when nothing was, as for a material library. Files added to stale
+// were built from source and are converted again after the debounce time.
+typedef bool (*WatchCallback)(const std::string& source, std::string& output, std::vector<std::string>& stale, void* user);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: WatchServer
+// Keeps converting while the process lives: .obj, .m3d and .mtl files saved
+// under the watched directories are handed to the callback once they have been
+// quiet for the debounce time, and clients of the Unix socket can ask for a
+// conversion directly. Requests are lines of text:
+//   convert <path>   answered with "ok <written file>" or "error <path>"
+//   quit             answered with "ok", then Run() returns
+// Everything runs on the thread calling Run(), one conversion at a time, so
+// the callback can use the job arena and the material cache as they are.
+// Watching needs inotify; elsewhere AddDirectory() and Listen() fail.
+////////////////////////////////////////////////////////////////////////////////
+class WatchServer
+{
+public:
+	WatchServer();
+	~WatchServer();
+
+	// Watches a directory and every directory below it.
+	bool AddDirectory(const char* path);
+
+	bool Listen(const char* path);
+
+	// Returns true when stopped by "quit" or an interrupt.
+	bool Run(WatchCallback callback, void* user, unsigned int debounceMs);
+
+private:
+	WatchServer(const WatchServer&);
+	WatchServer& operator=(const WatchServer&);
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Client
+	{
+		int Socket;
+		std::string Received;
+	};
+
+	bool WatchTree(const std::string& path);
+	void ReadEvents();
+	void AcceptClient();
+	bool ReadClient(Client& client, WatchCallback callback, void* user);
+	void ConvertDue(WatchCallback callback, void* user);
+	void Queue(const std::vector<std::string>& paths);
+	int Timeout() const;
+
+private:
+	int m_inotify;
+	int m_listen;
+	std::string m_socketPath;
+	std::map<int, std::string> m_directories;
+	std::vector<Client> m_clients;
+	std::map<std::string, Clock::time_point> m_due;
+	unsigned int m_debounce;
+	bool m_quit;
+};
+
+#endif
@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: XMCompat.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _XMCOMPAT_H_
+#define _XMCOMPAT_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#ifdef _WIN32
+#include <DirectXMath.h>
+#else
+
+// DirectXMath only ships with the Windows SDK. The parser only stores the
+// float vector types, so other platforms get layout compatible stand-ins.
+namespace DirectX
+{
+	struct XMFLOAT2
+	{
+		float x, y;
+
+		XMFLOAT2() {}
+		XMFLOAT2(float _x, float _y) : x(_x), y(_y) {}
+	};
+
+	struct XMFLOAT3
+	{
+		float x, y, z;
+
+		XMFLOAT3() {}
+		XMFLOAT3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+	};
+
+	struct XMFLOAT4
+	{
+		float x, y, z, w;
+
+		XMFLOAT4() {}
+		XMFLOAT4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+	};
+
+	// Rows 0 to 2 hold the rotation and row 3 the translation, for row vectors.
+	struct XMFLOAT4X3
+	{
+		float m[4][3];
+
+		XMFLOAT4X3() {}
+	};
+}
+
+#endif
+
+#endif
@@ -6,1056 +6,704 @@
 //////////////
 // INCLUDES //
 //////////////
+#include <algorithm>
 #include <iostream>
 #include <fstream>
-#include <DirectXMath.h>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
 #include <string>
+#include <vector>
+#include "ModelParser.h"
+#include "MappedFile.h"
+#include "Pack.h"
+#include "TextWriter.h"
+#include "Watch.h"
 using namespace DirectX;
 using namespace std;
 
+
 //////////////
 // TYPEDEFS //
 //////////////
-typedef unsigned int UINT;
-typedef unsigned long ULONG;
-
-struct SubsetTableDesc
-{
-	UINT SubsetID;
-	ULONG VertexStart;
-	ULONG VertexCount;
-	ULONG FaceStart;
-	ULONG FaceCount;
-};
-
-struct MatrialDesc
-{
-	XMFLOAT3 Ambient;
-	XMFLOAT3 Diffuse;
-	XMFLOAT3 Specular;
-	float SpecPower;
-	XMFLOAT3 Reflectivity;
-	float AlphaClip;
-};
 
-typedef struct
+// What every file of a batch is converted with.
+struct ConvertOptions
 {
-	float x, y, z;
-}VertexType;
-
-typedef struct
-{
-	int vIndex1, vIndex2, vIndex3, vIndex4;
-	int tIndex1, tIndex2, tIndex3, tIndex4;
-	int nIndex1, nIndex2, nIndex3, nIndex4;
-	int Count;
-	unsigned int ID;
-}FaceType;
-
-struct Header
-{
-	unsigned long VertexCount;
-	unsigned long IndexCount;
-	unsigned long bfOffBits;	
-	unsigned int ObjectCount;
+	CoordinateSystem Target;
+	UINT WriteFlags;
+	bool Instance;
+	InstanceOptions Instancing;
+	UINT BonePalette;
+	bool Collision;
+	CollisionOptions Collisions;
 };
 
-struct vertexData
-{
-	XMFLOAT3 pos;
-	XMFLOAT2 tex;
-	XMFLOAT3 Normal;
-	unsigned int ID;
-};
 
-struct Body
-{
-	vertexData* vertices;
-	unsigned long* Indices;
-	unsigned int* textureSize;
-	char** textureName;
-};
+/////////////
+// GLOBALS //
+/////////////
+// Holds every allocation of the current conversion. Reset between files.
+Arena g_JobArena;
+// In watch mode, the material libraries each converted .obj read, by normalized path.
+map<string, vector<string> > g_WatchedLibraries;
 
 
 /////////////////////////
 // FUNCTION PROTOTYPES //
 /////////////////////////
 void GetModelFilename(char*);
-bool ReadFileCounts(char*, int&, int&, int&, int&, int&);
-bool LoadDataStructures(char*, int, int, int, int,int);
-bool PrintDataInFile(char*);
-bool M3DReadFileCounts(char*, UINT&, UINT&, UINT&, SubsetTableDesc**, MatrialDesc**);
-
-
-void fToXM(XMFLOAT3* xm, VertexType v)
-{
-	xm->x = v.x;
-	xm->y = v.y;
-	xm->z = v.z;
-}
-void fToXM(XMFLOAT2* xm, VertexType v)
-{
-	xm->x = v.x;
-	xm->y = v.y;
-}
-
-void insertData(vertexData* data, VertexType p, VertexType t, VertexType n, unsigned int id)
-{
-	fToXM(&data->pos, p);
-	fToXM(&data->tex, t);
-	fToXM(&data->Normal, n);
-	data->ID = id;
-}
-
-void readData(XMFLOAT4* xm, ifstream* s)
-{
-	char temp;
-	(*s) >> xm->x;
-	(*s).get(temp);
-	(*s) >> xm->y;
-	(*s).get(temp);
-	(*s) >> xm->z;
-	(*s).get(temp);
-	(*s) >> xm->w;
-}
-
-void readData(XMFLOAT3* xm, ifstream* s)
-{
-	char temp;
-	(*s) >> xm->x;
-	(*s).get(temp);
-	(*s) >> xm->y;
-	(*s).get(temp);
-	(*s) >> xm->z;
-}
-
-void readData(XMFLOAT2* xm, ifstream* s)
-{
-	char temp;
-	(*s) >> xm->x;
-	(*s).get(temp);
-	(*s) >> xm->y;
-}
-
-void readData(float* xm, ifstream* s)
-{
-	char temp;
-	(*s) >> (*xm);
-}
+bool PrintDataInFile(char*, const InspectOptions&, const char*);
+bool PrintPack(const PackView&);
+bool ConvertFile(char*, const ConvertOptions&, ConversionStats*, PackWriter*);
+bool ConvertWatchedFile(const string&, string&, vector<string>&, void*);
+bool WriteStatsReport(const char*, const vector<ConversionStats>&);
+bool AnalyzeFile(char*, float, float);
 
-std::string removeExtension(const std::string& filename) {
-	size_t lastdot = filename.find_last_of(".");
-	if (lastdot == std::string::npos) return filename;
-	return filename.substr(0, lastdot);
-}
-std::string GetExtension(const std::string& filename)
-{
-	std::string::size_type idx;
-
-	idx = filename.rfind('.');
-
-	if (idx != std::string::npos)
-	{
-		return filename.substr(idx + 1);
-	}
-	else
-	{
-		// No extension found
-	}
-}
 
 //////////////////
 // MAIN PROGRAM //
 //////////////////
-int main()
+int main(int argc, char* argv[])
 {
 	bool result;
 	char filename[256];
 	
 	char garbage;
 
-	// Read in the name of the model file.
-	GetModelFilename(filename);
-
-	
-
-	cin >> garbage;
-	if (garbage == 's')
-	{
-		PrintDataInFile(filename);
-		cin >> garbage;
-		return 0;
-	}
-
-	string ext = GetExtension(string(filename));
-
-	if (ext == "m3d")
-	{
-		UINT vertexCount, faceCount, objectCount;
-		SubsetTableDesc* SubsetTable;
-		MatrialDesc* Material;
-		M3DReadFileCounts(filename, vertexCount, faceCount, objectCount, &SubsetTable, &Material);
-	}
-	else if (ext == "obj")
-	{
-		int vertexCount, textureCount, normalCount, faceCount, objectCount;
-
-		// Read in the number of vertices, tex coords, normals, and faces so that the data structures can be initialized with the exact sizes needed.
-		result = ReadFileCounts(filename, vertexCount, textureCount, normalCount, faceCount, objectCount);
-		if (!result)
+	vector<char*> files;
+	vector<char*> watchDirectories;
+	const char* socketFile = 0;
+	UINT debounce = 250;
+	const char* statsFile = 0;
+	const char* packFile = 0;
+	const char* model = 0;
+	bool analyze = false;
+	bool inspect = false;
+	InspectOptions inspectOptions;
+	ConvertOptions convertOptions;
+
+	DefaultInspectOptions(inspectOptions);
+	DefaultCoordinateSystem(convertOptions.Target);
+	DefaultInstanceOptions(convertOptions.Instancing);
+	DefaultCollisionOptions(convertOptions.Collisions);
+	convertOptions.WriteFlags = 0;
+	convertOptions.Instance = false;
+	convertOptions.BonePalette = 0;
+	convertOptions.Collision = false;
+	float maxAcmr = 0.0f, maxOverdraw = 0.0f;
+
+	// Read the options, everything else is a file to convert.
+	for (int i = 1; i < argc; i++)
+	{
+		if (string(argv[i]) == "--stats" && i + 1 < argc)
 		{
-			return -1;
+			statsFile = argv[++i];
 		}
-
-		// Display the counts to the screen for information purposes.
-		cout << endl;
-		cout << "Parts: " << objectCount << endl;
-		cout << "Vertices: " << vertexCount << endl;
-		cout << "UVs:      " << textureCount << endl;
-		cout << "Normals:  " << normalCount << endl;
-		cout << "Faces:    " << faceCount << endl;
-
-		// Now read the data from the file into the data structures and then output it in our model format.
-		result = LoadDataStructures(filename, vertexCount, textureCount, normalCount, faceCount, objectCount);
-		if (!result)
+		else if (string(argv[i]) == "--pack" && i + 1 < argc)
 		{
-			return -2;
+			packFile = argv[++i];
 		}
-	}
-
-	
-	
-
-	// Notify the user the model has been converted.
-	cout << "\nFile has been converted." << endl;
-
-	return 0;
-}
-
-
-
-void GetModelFilename(char* filename)
-{
-	bool done;
-	ifstream fin;
-
-
-	// Loop until we have a file name.
-	done = false;
-	while (!done)
-	{
-		// Ask the user for the filename.
-		cout << "Enter model filename: ";
-
-		// Read in the filename.
-		cin >> filename;
-
-
-
-		// Attempt to open the file.
-		fin.open(filename);
-
-		if (fin.good())
+		else if (string(argv[i]) == "--model" && i + 1 < argc)
 		{
-			// If the file exists and there are no problems then exit since we have the file name.
-			done = true;
+			model = argv[++i];
 		}
-		else
+		else if (string(argv[i]) == "--watch" && i + 1 < argc)
 		{
-			// If the file does not exist or there was an issue opening it then notify the user and repeat the process.
-			fin.clear();
-			cout << endl;
-			cout << "File " << filename << " could not be opened." << endl << endl;
+			watchDirectories.push_back(argv[++i]);
 		}
-	}
-
-	return;
-}
-
-
-bool ReadFileCounts(char* filename, int& vertexCount, int& textureCount, int& normalCount, int& faceCount, int& objectCount)
-{
-	ifstream fin;
-	char input;
-	int byteWidth = 0;
-
-	// Initialize the counts.
-	vertexCount = 0;
-	textureCount = 0;
-	normalCount = 0;
-	faceCount = 0;
-	objectCount = 0;
-
-	// Open the file.
-	fin.open(filename);
-
-	// Check if it was successful in opening the file.
-	if (fin.fail() == true)
-	{
-		return false;
-	}
-
-	// Read from the file and continue to read until the end of the file is reached.
-	fin.get(input);
-	while (!fin.eof())
-	{
-		// If the line starts with 'v' then count either the vertex, the texture coordinates, or the normal vector.
-		if (input == 'v')
+		else if (string(argv[i]) == "--socket" && i + 1 < argc)
 		{
-			fin.get(input);
-			if (input == ' ') { vertexCount++; }
-			if (input == 't') { textureCount++; }
-			if (input == 'n') { normalCount++; }
+			socketFile = argv[++i];
 		}
-
-		// If the line starts with 'f' then increment the face count.
-		if (input == 'f')
+		else if (string(argv[i]) == "--debounce" && i + 1 < argc)
 		{
-			fin.get(input);
-			if (input == ' ') { faceCount++; }
+			debounce = (UINT)atoi(argv[++i]);
 		}
-
-		if (input == 'o' || input == 'g')
+		else if (string(argv[i]) == "--compress")
 		{
-			fin.get(input);
-			if (input == ' ')
+			convertOptions.WriteFlags |= SMF_WRITE_COMPRESS;
+		}
+		else if (string(argv[i]) == "--skin")
+		{
+			convertOptions.WriteFlags |= SMF_WRITE_SKIN;
+		}
+		else if (string(argv[i]) == "--bone-palette" && i + 1 < argc)
+		{
+			// Palettes only mean something with the blend data they index.
+			convertOptions.BonePalette = (UINT)atoi(argv[++i]);
+			convertOptions.WriteFlags |= SMF_WRITE_SKIN;
+			if (convertOptions.BonePalette < 12 || convertOptions.BonePalette > 256)
 			{
-				objectCount++;
+				cout << "Invalid bone palette size " << argv[i] << ", it takes 12 to 256 bones" << endl;
+				return -1;
 			}
 		}
-
-		// Otherwise read in the remainder of the line.
-		while (input != '\n')
+		else if (string(argv[i]) == "--collision")
 		{
-			fin.get(input);
+			convertOptions.Collision = true;
 		}
-
-		// Start reading the beginning of the next line.
-		fin.get(input);
-	}
-
-	// Close the file.
-	fin.close();
-
-	return true;
-}
-
-
-bool LoadDataStructures(char* filename, int vertexCount, int textureCount, int normalCount, int faceCount,int objectCount)
-{
-	VertexType *vertices, *texcoords, *normals;
-	FaceType *faces;
-	ifstream fin;
-	int vertexIndex, texcoordIndex, normalIndex, faceIndex, vIndex, tIndex, nIndex, objectIndex;
-	char input, input2;
-	ofstream fout;
-	ofstream bout;
-	bool dr = false;
-
-
-	// Initialize the four data structures.
-	vertices = new VertexType[vertexCount];
-	if (!vertices)
-	{
-		return false;
-	}
-
-	texcoords = new VertexType[textureCount];
-	if (!texcoords)
-	{
-		return false;
-	}
-
-	normals = new VertexType[normalCount];
-	if (!normals)
-	{
-		return false;
-	}
-
-	faces = new FaceType[faceCount];
-	if (!faces)
-	{
-		return false;
-	}
-
-	string* textureArray = new string[objectCount];
-	if (!textureArray)
-	{
-		return false;
-	}
-
-	// Initialize the indexes.
-	vertexIndex = 0;
-	texcoordIndex = 0;
-	normalIndex = 0;
-	faceIndex = 0;
-	objectIndex = -1;
-
-	// Open the file.
-	fin.open(filename);
-
-	// Check if it was successful in opening the file.
-	if (fin.fail() == true)
-	{
-		return false;
-	}
-	int vCount = 0;
-	// Read in the vertices, texture coordinates, and normals into the data structures.
-	// Also convert to left hand coordinate
-	fin.get(input);
-	while (!fin.eof())
-	{
-		if (input == 'v')
+		else if (string(argv[i]) == "--hull-vertices" && i + 1 < argc)
 		{
-			fin.get(input);
-
-			// Read in the vertices.
-			if (input == ' ')
+			// A hull below a tetrahedron has no volume to collide with.
+			convertOptions.Collisions.MaxHullVertices = (UINT)atoi(argv[++i]);
+			convertOptions.Collision = true;
+			if (convertOptions.Collisions.MaxHullVertices < 4)
 			{
-				fin >> vertices[vertexIndex].x >> vertices[vertexIndex].y >> vertices[vertexIndex].z;
-
-				//Invert the Z vertex to change to left hand system.
-				vertices[vertexIndex].z = vertices[vertexIndex].z * -1.0f;
-				vertexIndex++;
+				cout << "Invalid hull vertex limit " << argv[i] << ", a hull needs at least 4 vertices" << endl;
+				return -1;
 			}
-
-			// Read in the texture uv coordinates.
-			if (input == 't')
+		}
+		else if (string(argv[i]) == "--hulls" && i + 1 < argc)
+		{
+			convertOptions.Collisions.MaxHulls = (UINT)atoi(argv[++i]);
+			convertOptions.Collision = true;
+			if (convertOptions.Collisions.MaxHulls < 1)
 			{
-				fin >> texcoords[texcoordIndex].x >> texcoords[texcoordIndex].y;
-
-				// Invert the V texture coordinates to left hand system.
-				texcoords[texcoordIndex].y = 1.0f - texcoords[texcoordIndex].y;
-				texcoordIndex++;
+				cout << "Invalid hull count " << argv[i] << endl;
+				return -1;
 			}
-
-			// Read in the normals.
-			if (input == 'n')
+		}
+		else if (string(argv[i]) == "--instance")
+		{
+			convertOptions.Instance = true;
+		}
+		else if (string(argv[i]) == "--right-handed")
+		{
+			convertOptions.Target.Handedness = HANDED_RIGHT;
+		}
+		else if (string(argv[i]) == "--z-up")
+		{
+			convertOptions.Target.UpAxis = UP_AXIS_Z;
+		}
+		else if (string(argv[i]) == "--ccw")
+		{
+			convertOptions.Target.Winding = WINDING_CCW;
+		}
+		else if (string(argv[i]) == "--uv-bottom-left")
+		{
+			convertOptions.Target.UVOrigin = UV_ORIGIN_BOTTOM_LEFT;
+		}
+		else if (string(argv[i]) == "--unit-scale" && i + 1 < argc)
+		{
+			convertOptions.Target.UnitScale = (float)atof(argv[++i]);
+			if (!(convertOptions.Target.UnitScale > 0.0f))
 			{
-				fin >> normals[normalIndex].x >> normals[normalIndex].y >> normals[normalIndex].z;
-
-				// Invert the Z normal to change to left hand system.
-				normals[normalIndex].z = normals[normalIndex].z * -1.0f;
-				normalIndex++;
+				cout << "Invalid unit scale " << argv[i] << endl;
+				return -1;
 			}
 		}
-
-		// Read in the faces.
-		if (input == 'f')
+		else if (string(argv[i]) == "--analyze")
+		{
+			analyze = true;
+		}
+		else if (string(argv[i]) == "--inspect")
+		{
+			inspect = true;
+		}
+		else if (string(argv[i]) == "--subset" && i + 1 < argc)
 		{
-			fin.get(input);
-			if (input == ' ')
+			inspectOptions.Subsets.push_back((UINT)atoi(argv[++i]));
+		}
+		else if (string(argv[i]) == "--vertices" && i + 1 < argc)
+		{
+			inspectOptions.DumpVertices = ParseRange(argv[++i], inspectOptions.VertexBegin, inspectOptions.VertexEnd);
+			if (!inspectOptions.DumpVertices)
 			{
-				// Read the face data in backwards to convert it to a left hand system from right hand system.
-
-				fin >> faces[faceIndex].vIndex4 >> input2 >> faces[faceIndex].tIndex4 >> input2 >> faces[faceIndex].nIndex4
-					>> faces[faceIndex].vIndex3 >> input2 >> faces[faceIndex].tIndex3 >> input2 >> faces[faceIndex].nIndex3
-					>> faces[faceIndex].vIndex2 >> input2 >> faces[faceIndex].tIndex2 >> input2 >> faces[faceIndex].nIndex2;
-				
-				fin.get(input);
-				if (input == ' ')
-				{
-					fin >> faces[faceIndex].vIndex1 >> input2 >> faces[faceIndex].tIndex1 >> input2 >> faces[faceIndex].nIndex1;
-					faces[faceIndex].Count = 4;
-					vCount += 6;
-					dr = false;
-
-				}
-				else
-				{
-					faces[faceIndex].Count = 3;
-					vCount += 3;
-					dr = false;
-				}
-				faces[faceIndex].ID = objectIndex ;
-
-				faceIndex++;
+				cout << "Invalid vertex range " << argv[i] << endl;
+				return -1;
 			}
-
-
-			
 		}
-
-		if (input == 'o' || input == 'g')
+		else if (string(argv[i]) == "--indices" && i + 1 < argc)
 		{
-			fin.get(input);
-			if (input == ' ')
+			inspectOptions.DumpIndices = ParseRange(argv[++i], inspectOptions.IndexBegin, inspectOptions.IndexEnd);
+			if (!inspectOptions.DumpIndices)
 			{
-				objectIndex++;
+				cout << "Invalid index range " << argv[i] << endl;
+				return -1;
 			}
 		}
+		else if (string(argv[i]) == "--max-acmr" && i + 1 < argc)
+		{
+			maxAcmr = (float)atof(argv[++i]);
+		}
+		else if (string(argv[i]) == "--max-overdraw" && i + 1 < argc)
+		{
+			maxOverdraw = (float)atof(argv[++i]);
+		}
+		else
+		{
+			files.push_back(argv[i]);
+		}
+	}
 
-		if (input == 'u')
+	// Print the header and summary of .smf files, plus any selected ranges.
+	if (inspect)
+	{
+		int failed = 0;
+		for (size_t i = 0; i < files.size(); i++)
 		{
-			fin.get(input);
-			if (input == 's')
+			if (!PrintDataInFile(files[i], inspectOptions, model))
 			{
-				fin.get(input);
-				if (input == 'e')
-				{
-					fin.get(input);
-					if (input == 'm')
-					{
-						fin.get(input);
-						if (input == 't')
-						{
-							fin.get(input);
-							if (input == 'l')
-							{
-								fin.get(input);
-								if (input == ' ')
-								{
-									getline(fin, textureArray[objectIndex]);
-									int test = 0;
-								}
-							}
-						}
-					}
-				}
+				cout << "File " << files[i] << " could not be inspected." << endl;
+				failed++;
 			}
 		}
 
+		return failed ? -1 : 0;
+	}
 
-		while (input != '\n')
+	// Report mesh quality of .smf files, failing when a limit is exceeded.
+	if (analyze)
+	{
+		int failed = 0;
+		for (size_t i = 0; i < files.size(); i++)
 		{
-			fin.get(input);
+			if (!AnalyzeFile(files[i], maxAcmr, maxOverdraw))
+			{
+				failed++;
+			}
 		}
 
-		// Start reading the beginning of the next line.
-		fin.get(input);
-
+		return failed ? -1 : 0;
 	}
 
-	// Close the file.
-	fin.close();
-
-	string name = string(filename);
+	// Keep converting saved files and answering requests until told to stop.
+	// The arena and the material cache stay warm from one file to the next.
+	if (!watchDirectories.empty() || socketFile)
+	{
+		WatchServer server;
+		if (packFile)
+		{
+			cout << "Watch mode writes .smf files and cannot fill a pack." << endl;
+			return -1;
+		}
 
-	bout.open(removeExtension(name) + ".smf", ios_base::binary);
+		for (size_t i = 0; i < watchDirectories.size(); i++)
+		{
+			if (!server.AddDirectory(watchDirectories[i]))
+			{
+				cout << "Directory " << watchDirectories[i] << " could not be watched." << endl;
+				return -1;
+			}
+			cout << "Watching " << watchDirectories[i] << endl;
+		}
 
-	Header head;
-	head.VertexCount = vCount;
-	head.IndexCount = vCount;
-	head.bfOffBits = sizeof(Header);
-	head.ObjectCount = objectCount;
+		if (socketFile)
+		{
+			if (!server.Listen(socketFile))
+			{
+				cout << "Socket " << socketFile << " could not be opened." << endl;
+				return -1;
+			}
+			cout << "Listening on " << socketFile << endl;
+		}
 
-	bout.write((char*)&head, sizeof(Header));
+		result = server.Run(ConvertWatchedFile, &convertOptions, debounce);
 
-	vertexData* data = new vertexData[head.VertexCount];
-	unsigned long* Indices = new unsigned long[head.IndexCount];
+		cout << endl << "Arena high-water mark: " << g_JobArena.HighWater() << " bytes, ";
+		cout << g_JobArena.BlockAllocations() << " block allocations" << endl;
 
-	for (unsigned long i = 0; i < head.IndexCount; i++)
-	{
-		Indices[i] = i;
+		return result ? 0 : -1;
 	}
 
-	unsigned int* textureSize = new unsigned int[head.ObjectCount];
-	for (unsigned int i = 0; i < head.ObjectCount; i++)
+	// Convert every file given on the command line as one batch, either to
+	// .smf files next to them or into a single pack.
+	if (!files.empty())
 	{
-		textureSize[i] = textureArray[i].size();
-	}
+		vector<ConversionStats> stats(statsFile ? files.size() : 0);
+		int failed = 0;
 
-	int index = 0;
-	for (int i = 0; i < faceCount; i++)
-	{
-		if (faces[i].Count == 4)
+		PackWriter pack;
+		if (packFile && !pack.Open(packFile))
 		{
-			vIndex = faces[i].vIndex1 - 1;
-			tIndex = faces[i].tIndex1 - 1;
-			nIndex = faces[i].nIndex1 - 1;
-
-			insertData(&data[index], vertices[vIndex], texcoords[tIndex], normals[nIndex], faces[i].ID);
-
-			index++;
-
-			vIndex = faces[i].vIndex2 - 1;
-			tIndex = faces[i].tIndex2 - 1;
-			nIndex = faces[i].nIndex2 - 1;
-
-			insertData(&data[index], vertices[vIndex], texcoords[tIndex], normals[nIndex], faces[i].ID);
-
-			index++;
-
-			vIndex = faces[i].vIndex3 - 1;
-			tIndex = faces[i].tIndex3 - 1;
-			nIndex = faces[i].nIndex3 - 1;
-
-			insertData(&data[index], vertices[vIndex], texcoords[tIndex], normals[nIndex], faces[i].ID);
-
-			index++;
-
-			insertData(&data[index], vertices[vIndex], texcoords[tIndex], normals[nIndex], faces[i].ID);
-
-			index++;
-
-			vIndex = faces[i].vIndex4 - 1;
-			tIndex = faces[i].tIndex4 - 1;
-			nIndex = faces[i].nIndex4 - 1;
-
-			insertData(&data[index], vertices[vIndex], texcoords[tIndex], normals[nIndex], faces[i].ID);
-
-			index++;
-
-			vIndex = faces[i].vIndex1 - 1;
-			tIndex = faces[i].tIndex1 - 1;
-			nIndex = faces[i].nIndex1 - 1;
-
-			insertData(&data[index], vertices[vIndex], texcoords[tIndex], normals[nIndex], faces[i].ID);
-
-			index++;
-
+			cout << "Pack " << packFile << " could not be created." << endl;
+			return -1;
 		}
-		else
-		{
-			vIndex = faces[i].vIndex2 - 1;
-			tIndex = faces[i].tIndex2 - 1;
-			nIndex = faces[i].nIndex2 - 1;
 
-			insertData(&data[index], vertices[vIndex], texcoords[tIndex], normals[nIndex], faces[i].ID);
-
-			index++;
-
-			vIndex = faces[i].vIndex3 - 1;
-			tIndex = faces[i].tIndex3 - 1;
-			nIndex = faces[i].nIndex3 - 1;
-
-			insertData(&data[index], vertices[vIndex], texcoords[tIndex], normals[nIndex], faces[i].ID);
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			ConversionStats* fileStats = 0;
+			if (statsFile)
+			{
+				fileStats = &stats[i];
+				ResetStats(*fileStats, files[i]);
+			}
 
-			index++;
+			cout << endl << files[i] << endl;
+			result = ConvertFile(files[i], convertOptions, fileStats, packFile ? &pack : 0);
+			if (!result)
+			{
+				cout << "File " << files[i] << " could not be converted." << endl;
+				failed++;
+			}
+		}
 
-			vIndex = faces[i].vIndex4 - 1;
-			tIndex = faces[i].tIndex4 - 1;
-			nIndex = faces[i].nIndex4 - 1;
+		if (packFile && !pack.Close())
+		{
+			cout << "Pack " << packFile << " could not be written." << endl;
+			failed++;
+		}
 
-			insertData(&data[index], vertices[vIndex], texcoords[tIndex], normals[nIndex], faces[i].ID);
+		cout << endl << "Arena high-water mark: " << g_JobArena.HighWater() << " bytes, ";
+		cout << g_JobArena.BlockAllocations() << " block allocations" << endl;
 
-			index++;
+		if (statsFile && !WriteStatsReport(statsFile, stats))
+		{
+			cout << "Stats report " << statsFile << " could not be written." << endl;
 		}
 
+		return failed ? -1 : 0;
 	}
 
-	bout.write((char*)data, sizeof(vertexData)*head.VertexCount);
-	bout.write((char*)Indices, sizeof(unsigned long)*head.IndexCount);
-	bout.write((char*)textureSize, sizeof(unsigned int)*head.ObjectCount);
-	for (unsigned int i = 0; i < head.ObjectCount; i++)
-	{
-		bout.write((char*)textureArray[i].c_str(), textureSize[i]);
-	}
+	// Read in the name of the model file.
+	GetModelFilename(filename);
 
-	bout.close();
+	
 
-	// Release the four data structures.
-	if (vertices)
-	{
-		delete[] vertices;
-		vertices = 0;
-	}
-	if (texcoords)
-	{
-		delete[] texcoords;
-		texcoords = 0;
-	}
-	if (normals)
+	cin >> garbage;
+	if (garbage == 's')
 	{
-		delete[] normals;
-		normals = 0;
+		PrintDataInFile(filename, inspectOptions, 0);
+		cin >> garbage;
+		return 0;
 	}
-	if (faces)
+	if (garbage == 'a')
 	{
-		delete[] faces;
-		faces = 0;
+		AnalyzeFile(filename, 0.0f, 0.0f);
+		cin >> garbage;
+		return 0;
 	}
 
-	return true;
-}
-
-
-bool PrintDataInFile(char* filename)
-{
-	FILE* filePtr;
-	Header head;
-	int count;
-	int error = fopen_s(&filePtr, filename, "rb");
-	if (error != 0)
+	result = ConvertFile(filename, convertOptions, 0, 0);
+	if (!result)
 	{
-		return -3;
+		return -1;
 	}
 
-	count = fread(&head, sizeof(Header), 1, filePtr);
-
-	cout << "VertexCount: " << head.VertexCount << endl;
-	cout << "IndexCount: " << head.IndexCount << endl;
-	cout << "ObjectCount: " << head.ObjectCount << endl;
-	cout << "bfOffBits: " << head.bfOffBits << endl << endl;
-
-	vertexData* data = new vertexData[head.VertexCount];
-	unsigned long* indices = new unsigned long[head.IndexCount];
-	unsigned int* textureSize = new unsigned int[head.ObjectCount];
-	char** textureArray = new char*[head.ObjectCount];
-	MatrialDesc* mA = new MatrialDesc[head.ObjectCount];
-
-	fseek(filePtr, head.bfOffBits, SEEK_SET);
-
+	// Notify the user the model has been converted.
+	cout << "\nFile has been converted." << endl;
+	cout << "Arena high-water mark: " << g_JobArena.HighWater() << " bytes" << endl;
 
-	fread(mA, sizeof(MatrialDesc), head.ObjectCount, filePtr);
+	return 0;
+}
 
-	fread(data, sizeof(vertexData), head.VertexCount, filePtr);
-	fread(indices, sizeof(unsigned long), head.IndexCount, filePtr);
-	fread(textureSize, sizeof(unsigned int), head.ObjectCount, filePtr);
 
+bool ConvertFile(char* filename, const ConvertOptions& options, ConversionStats* stats, PackWriter* pack)
+{
+	bool result;
+	Mesh mesh;
 
-	for (unsigned int i = 0; i < head.ObjectCount; i++)
+	result = LoadModel(filename, g_JobArena, mesh, stats, &options.Target);
+	if (result && options.BonePalette)
 	{
-		textureArray[i] = new char[textureSize[i]];
+		// Subsets needing more bones than a draw can bind are split up.
+		StageTimer palette(stats, STAGE_PALETTE, g_JobArena);
+		result = SplitBonePalettes(mesh, options.BonePalette, g_JobArena);
+		palette.Stop(sizeof(vertexData) * mesh.VertexCount + sizeof(ULONG) * mesh.IndexCount);
 	}
-	for (unsigned int i = 0; i < head.ObjectCount; i++)
+	if (result && options.Instance)
 	{
-		fread(textureArray[i], textureSize[i], 1, filePtr);
+		// Repeated objects are stored once and placed by the instance table.
+		StageTimer instance(stats, STAGE_INSTANCE, g_JobArena);
+		result = FindInstances(mesh, options.Instancing, g_JobArena);
+		instance.Stop(sizeof(vertexData) * mesh.VertexCount + sizeof(ULONG) * mesh.IndexCount);
 	}
-
-	
-
-	for (unsigned int i = 0; i < head.ObjectCount; i++)
+	if (result && options.Collision)
 	{
-		cout << "Ambient" << i << ": " << mA[i].Ambient.x << ", " << mA[i].Ambient.y << ", " << mA[i].Ambient.z << endl;
-		cout << "Diffuse" << i << ": " << mA[i].Diffuse.x << ", " << mA[i].Diffuse.y << ", " << mA[i].Diffuse.z << endl;
-		cout << "Specular" << i << ": " << mA[i].Specular.x << ", " << mA[i].Specular.y << ", " << mA[i].Specular.z << endl;
-		cout << "SpecPower" << i << ": " << mA[i].SpecPower << endl;
-		cout << "Reflectivity" << i << ": " << mA[i].Reflectivity.x << ", " << mA[i].Reflectivity.y << ", " << mA[i].Reflectivity.z << endl;
-		cout << "AlphaClip" << i << ": " << mA[i].AlphaClip << endl;
-
-		cout << "textureSize" << i << ": " << textureSize[i] << endl;
-		cout << "TextureName" << i << ": " << textureArray[i] << endl;
+		// Every subset gets convex hulls a physics engine can take as they are.
+		StageTimer collision(stats, STAGE_COLLISION, g_JobArena);
+		result = BuildCollisionHulls(mesh, options.Collisions, options.Target, g_JobArena);
+		collision.Stop(sizeof(vertexData) * mesh.VertexCount + sizeof(ULONG) * mesh.IndexCount);
 	}
-
-	cout << endl;
-
-	for (int i = 0; i < head.VertexCount; i++)
+	if (result)
 	{
-		cout << "Point" << i << ": " << data[i].pos.x << ", " << data[i].pos.y << ", " << data[i].pos.z << " | " << data[i].tex.x << ", " << data[i].tex.y << " | " << data[i].Normal.x << ", " << data[i].Normal.y << ", " << data[i].Normal.z << " | " << data[i].ID << endl;
+		// Display the counts to the screen for information purposes.
+		cout << endl;
+		cout << "Parts: " << mesh.ObjectCount << endl;
+		cout << "Vertices: " << mesh.VertexCount << endl;
+		cout << "Indices:  " << mesh.IndexCount << endl;
+		if (mesh.InstanceCount)
+		{
+			cout << "Instances: " << mesh.InstanceCount << endl;
+		}
+		if (mesh.HullCount)
+		{
+			cout << "Hulls: " << mesh.HullCount << endl;
+		}
+
+		unsigned long long written = 0;
+		StageTimer write(stats, STAGE_SMF_WRITE, g_JobArena);
+		if (pack)
+		{
+			result = pack->Add(removeExtension(string(filename)), mesh, options.WriteFlags, &g_JobArena, &written);
+		}
+		else
+		{
+			result = WriteSMF(mesh, (removeExtension(string(filename)) + ".smf").c_str(), options.WriteFlags, &g_JobArena, &written);
+		}
+		write.Stop(result ? written : 0);
 	}
-	cout << "Index: " << endl << endl;
 
-	for (int i = 0; i < head.IndexCount; i++)
+	if (stats)
 	{
-		cout << indices[i] << ", ";
+		stats->Succeeded = result;
 	}
 
-	return true;
-}
-
-
-
-
-
-
-
+	// Everything the conversion allocated goes away with the job.
+	g_JobArena.Reset();
 
+	return result;
+}
 
 
-bool M3DReadFileCounts(char* filename, UINT& vertexCount, UINT& faceCount, UINT& objectCount, SubsetTableDesc** ppSubSetTable, MatrialDesc** ppMaterial)
+bool ConvertWatchedFile(const string& source, string& output, vector<string>& stale, void* user)
 {
-	ifstream fin;
-	char input, input2;
-	int byteWidth = 0;
-	string temp;
-	// Initialize the counts.
-	vertexCount = 0;
-	faceCount = 0;
-	objectCount = 0;
-
-	// Open the file.
-	fin.open(filename);
-
-	// Check if it was successful in opening the file.
-	if (fin.fail() == true)
-	{
-		return false;
-	}
+	const ConvertOptions& options = *(const ConvertOptions*)user;
 
-	fin.get(input);
-	while (input != '#')
+	output.clear();
+	if (GetExtension(source) == "mtl")
 	{
-		fin.get(input);
-	}
-
-	// Read Material count
-	for (int k = 0; k < 10; k++)
-		fin.get(input);
-
-	fin >> objectCount;
-
-	// Read Vertex count
-	for (int k = 0; k < 10; k++)
-		fin.get(input);
+		// Every model that read the library is converted again with it.
+		ClearMaterialCache();
+		cout << endl << source << " changed, material libraries will be read again." << endl;
 
-	fin >> vertexCount;
+		string library = NormalizePath(source);
+		for (map<string, vector<string> >::const_iterator it = g_WatchedLibraries.begin(); it != g_WatchedLibraries.end(); ++it)
+		{
+			if (find(it->second.begin(), it->second.end(), library) != it->second.end())
+			{
+				stale.push_back(it->first);
+			}
+		}
+		return true;
+	}
 
-	// Read FaceCount count
-	for (int k = 0; k < 11; k++)
-		fin.get(input);
+	vector<char> filename(source.begin(), source.end());
+	filename.push_back('\0');
 
-	fin >> faceCount;
+	// Only the libraries this conversion asks for are recorded against it.
+	vector<string> libraries;
+	TakeMaterialLibrariesUsed(libraries);
 
-	SubsetTableDesc*& sS = (*ppSubSetTable) = new SubsetTableDesc[objectCount];
-	MatrialDesc*& pM = (*ppMaterial) = new MatrialDesc[objectCount];
-	unsigned int* tSB = new unsigned int[objectCount];
-	unsigned int* tSN = new unsigned int[objectCount];
-	string* tB = new string[objectCount];
-	string* tN = new string[objectCount];
+	cout << endl << source << endl;
+	bool result = ConvertFile(&filename[0], options, 0, 0);
 
-	while (input != '*')
+	// A model that failed may only need its library fixed, so it is kept too.
+	TakeMaterialLibrariesUsed(libraries);
+	for (size_t i = 0; i < libraries.size(); i++)
 	{
-		fin.get(input);
+		libraries[i] = NormalizePath(libraries[i]);
 	}
+	g_WatchedLibraries[source] = libraries;
 
-	for (int k = 0; k < 30; k++)
-		fin.get(input);
-
-	while (input == '*')
+	if (!result)
 	{
-		fin.get(input);
+		return false;
 	}
 
-	for (UINT i = 0; i < objectCount; i++)
-	{
-		// Read Ambient
-		for (int k = 0; k < 9; k++)
-			fin.get(input);
-
-		readData(&pM[i].Ambient, &fin);
-
-		// Read Diffuse
-		for (int k = 0; k < 9; k++)
-			fin.get(input);
-
-		readData(&pM[i].Diffuse, &fin);
-
-		// Read Specular
-		for (int k = 0; k < 11; k++)
-			fin.get(input);
-
-		readData(&pM[i].Specular, &fin);
+	output = removeExtension(source) + ".smf";
 
-		// Read Specular power
-		for (int k = 0; k < 11; k++)
-			fin.get(input);
-
-		readData(&pM[i].SpecPower, &fin);
+	return true;
+}
 
-		// Read Reflectivity
-		for (int k = 0; k < 14; k++)
-			fin.get(input);
 
-		readData(&pM[i].Reflectivity, &fin);
+void GetModelFilename(char* filename)
+{
+	bool done;
+	ifstream fin;
 
-		// Read AlphaClip
-		for (int k = 0; k < 11; k++)
-			fin.get(input);
 
-		readData(&pM[i].AlphaClip, &fin);
+	// Loop until we have a file name.
+	done = false;
+	while (!done)
+	{
+		// Ask the user for the filename.
+		cout << "Enter model filename: ";
 
-		// Read DiffuseMap
-		for (int k = 0; k < 27; k++)
-			fin.get(input);
+		// Read in the filename.
+		cin >> filename;
 
-		getline(fin, tB[i]);
-		tSB[i] = tB[i].size() + 1;
 
-		// Read NormalMap
-		for (int k = 0; k < 11; k++)
-			fin.get(input);
 
-		getline(fin, tN[i]);
-		tSN[i] = tN[i].size() + 1;
+		// Attempt to open the file.
+		fin.open(filename);
 
-		fin.get(input);
+		if (fin.good())
+		{
+			// If the file exists and there are no problems then exit since we have the file name.
+			done = true;
+		}
+		else
+		{
+			// If the file does not exist or there was an issue opening it then notify the user and repeat the process.
+			fin.clear();
+			cout << endl;
+			cout << "File " << filename << " could not be opened." << endl << endl;
+		}
 	}
 
+	return;
+}
 
 
-	while (input != '*')
-	{
-		fin.get(input);
-	}
-
-	for (int k = 0; k < 30; k++)
-		fin.get(input);
-
-	while (input == '*')
-	{
-		fin.get(input);
-	}
+bool PrintDataInFile(char* filename, const InspectOptions& options, const char* model)
+{
+	SMFView view;
+	bool result;
 
-	for (UINT i = 0; i < objectCount; i++)
+	// Packs list their contents, or inspect the model picked with --model.
+	if (GetExtension(string(filename)) == "pak")
 	{
-		// Read SubsetID
-		for (int k = 0; k < 10; k++)
-			fin.get(input);
-
-		fin >> sS[i].SubsetID;
-
-		// Read VertexStart
-		for (int k = 0; k <  14; k++)
-			fin.get(input);
-
-		fin >> sS[i].VertexStart;
+		MappedFile file;
+		PackView pack;
 
-		// Read VertexCount
-		for (int k = 0; k <  14; k++)
-			fin.get(input);
-
-		fin >> sS[i].VertexCount;
-
-		// Read FaceStart
-		for (int k = 0; k <  12; k++)
-			fin.get(input);
-
-		fin >> sS[i].FaceStart;
+		result = file.Open(filename) && ReadPack(file.Data(), file.Size(), pack);
+		if (result && !model)
+		{
+			return PrintPack(pack);
+		}
 
-		// Read FaceCount
-		for (int k = 0; k <  12; k++)
-			fin.get(input);
+		const PackEntry* entry = result ? FindPackEntry(pack, model) : 0;
+		result = entry && ReadPackModel(pack, *entry, g_JobArena, view);
+		if (result)
+		{
+			TextWriter out(stdout);
+			result = InspectSMF(view, options, g_JobArena, out);
+		}
 
-		fin >> sS[i].FaceCount;
+		g_JobArena.Reset();
 
+		return result;
 	}
 
-	while (input != '*')
+	result = LoadSMF(filename, g_JobArena, view);
+	if (result)
 	{
-		fin.get(input);
+		TextWriter out(stdout);
+		result = InspectSMF(view, options, g_JobArena, out);
 	}
 
-	for (int k = 0; k <  30; k++)
-		fin.get(input);
+	g_JobArena.Reset();
 
-	while (input == '*')
-	{
-		fin.get(input);
-	}
+	return result;
+}
 
-	vertexData* Vertices = new vertexData[vertexCount];
 
-	for (UINT j = 0; j < objectCount; j++)
+bool PrintPack(const PackView& pack)
+{
+	TextWriter out(stdout);
+
+	out << "Models: " << pack.Head->EntryCount << "\n";
+	out << "Slots: " << pack.Head->SlotCount << "\n";
+	out << "Alignment: " << pack.Head->Alignment << "\n";
+	for (UINT i = 0; i < pack.Head->SlotCount; i++)
 	{
-		for (ULONG i = sS[j].VertexStart; i < sS[j].VertexCount + sS[j].VertexStart; i++)
+		const PackEntry& entry = pack.Slots[i];
+		if (entry.Format == PACK_FORMAT_NONE)
 		{
-			// Read Position
-			for (int k = 0; k < 10; k++)
-				fin.get(input);
-
-			readData(&Vertices[i].pos, &fin);
-
-			// Read Tangent
-			for (int k = 0; k < 9; k++)
-				fin.get(input);
-
-			readData(&XMFLOAT4(0,0,0,0), &fin);
-
-			// Read Normal
-			for (int k = 0; k < 8; k++)
-				fin.get(input);
-
-			readData(&Vertices[i].Normal, &fin);
-
-			// Read Tex-Coords
-			for (int k = 0; k < 12; k++)
-				fin.get(input);
-
-			readData(&Vertices[i].tex, &fin);
-
-
-			// Skip Blend
-			fin.get(input);
-			fin.get(input);
-			while (input != '\n')
-			{
-				fin.get(input);
-			}
-			fin.get(input);
-			while (input != '\n')
-			{
-				fin.get(input);
-			}
-
-
-
-			Vertices[i].ID = j;
-
-
+			continue;
 		}
 
-
-
+		out.Write(pack.Names + entry.NameOffset, entry.NameLength);
+		out << ": " << entry.Size << " bytes at " << entry.Offset << "\n";
 	}
 
-	while (input != '*')
-	{
-		fin.get(input);
-	}
+	return true;
+}
 
-	for (int k = 0; k < 30; k++)
-		fin.get(input);
 
-	while (input == '*')
+bool WriteStatsReport(const char* filename, const vector<ConversionStats>& stats)
+{
+	ofstream fout;
+	ConversionStats total;
+
+	// A dash writes the report to the console.
+	bool console = string(filename) == "-";
+	if (!console)
 	{
-		fin.get(input);
+		fout.open(filename);
+		if (fout.fail() == true)
+		{
+			return false;
+		}
 	}
+	ostream& out = console ? cout : fout;
 
+	ResetStats(total, "total");
 
-	ULONG* Indices = new ULONG[faceCount * 3];
-	ULONG index = 0;
-	for (ULONG i = 0; i < faceCount; i++)
+	out << "{\"files\": [" << endl;
+	for (size_t i = 0; i < stats.size(); i++)
 	{
-		fin >> Indices[index];
-		fin.get(input);
-		index++;
+		out << "  ";
+		WriteStatsJSON(out, stats[i]);
+		out << (i + 1 < stats.size() ? "," : "") << endl;
 
-		fin >> Indices[index+1];
-		fin.get(input);
-		index++;
-
-		fin >> Indices[index-1];
-		fin.get(input);
-		index++;
+		AccumulateStats(total, stats[i]);
 	}
+	out << "], \"total\": ";
+	WriteStatsJSON(out, total);
+	out << "}" << endl;
 
-	string name = string(filename);
-	ofstream bout;
+	return !out.fail();
+}
 
-	bout.open(removeExtension(name) + ".smf", ios_base::binary);
 
-	Header head;
-	head.VertexCount = vertexCount;
-	head.IndexCount = faceCount*3;
-	head.bfOffBits = sizeof(Header);
-	head.ObjectCount = objectCount;
+bool AnalyzeFile(char* filename, float maxAcmr, float maxOverdraw)
+{
+	SMFView view;
+	AnalysisOptions options;
+	MeshMetrics* subsets;
+	MeshMetrics total;
+	bool result;
 
-	bout.write((char*)&head, sizeof(Header));
-	bout.write((char*)pM, sizeof(MatrialDesc)*head.ObjectCount);
+	DefaultAnalysisOptions(options);
 
-	bout.write((char*)Vertices, sizeof(vertexData)*head.VertexCount);
-	bout.write((char*)Indices, sizeof(ULONG)*head.IndexCount);
-	bout.write((char*)tSB, sizeof(UINT)*head.ObjectCount);
-	for (UINT i = 0; i < head.ObjectCount; i++)
+	result = LoadSMF(filename, g_JobArena, view) && AnalyzeMesh(view, options, g_JobArena, &subsets, total);
+	if (!result)
 	{
-		bout.write((char*)tB[i].c_str(), tSB[i]);
+		cout << "File " << filename << " could not be analyzed." << endl;
+		g_JobArena.Reset();
+		return false;
 	}
 
-	bout.close();
+	// One JSON object per file, with a line per subset and the whole mesh last.
+	cout << "{\"file\": \"" << JsonEscape(filename) << "\", \"fifo_cache\": " << options.FifoCacheSize << ", \"lru_cache\": " << options.LruCacheSize << ", \"subsets\": [" << endl;
+	for (UINT i = 0; i <= view.Head->ObjectCount; i++)
+	{
+		const MeshMetrics& m = i < view.Head->ObjectCount ? subsets[i] : total;
+		char line[512];
 
+		if (i == view.Head->ObjectCount)
+		{
+			cout << "], \"total\": ";
+		}
+		else
+		{
+			cout << "  ";
+		}
 
-	delete[]sS;
-	delete[]pM;
-	delete[]tSB;
-	delete[]tSN;
-	delete[]tB;
-	delete[]tN;
+		snprintf(line, sizeof(line), "{\"subset\": %u, \"triangles\": %lu, \"vertices\": %lu, \"acmr_fifo\": %.4f, \"atvr_fifo\": %.4f, \"acmr_lru\": %.4f, \"atvr_lru\": %.4f, \"overdraw\": %.4f, \"overfetch\": %.4f, \"fetch_efficiency\": %.4f}",
+			m.SubsetID, (unsigned long)m.Triangles, (unsigned long)m.Vertices, m.AcmrFifo, m.AtvrFifo, m.AcmrLru, m.AtvrLru, m.Overdraw, m.Overfetch, m.FetchEfficiency);
+		cout << line;
 
-	delete[]Vertices;
-	delete[]Indices;
+		if (i < view.Head->ObjectCount)
+		{
+			cout << (i + 1 < view.Head->ObjectCount ? "," : "") << endl;
+		}
 
-	// Close the file.
-	fin.close();
+		// Gate on the subsets so one bad part can not hide in the average.
+		if (i < view.Head->ObjectCount && m.Triangles)
+		{
+			if ((maxAcmr > 0.0f && m.AcmrFifo > maxAcmr) || (maxOverdraw > 0.0f && m.Overdraw > maxOverdraw))
+			{
+				result = false;
+			}
+		}
+	}
+	cout << "}" << endl;
+
+	g_JobArena.Reset();
 
-}
\ No newline at end of file
+	return result;
+}
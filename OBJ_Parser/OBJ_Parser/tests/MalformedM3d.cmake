@@ -0,0 +1,33 @@
+# Converts M3D files whose header claims more than the file holds, run by
+# ctest as
+#   cmake -DCONVERTER=<OBJ_Parser> -DWORK=<directory> -P MalformedM3d.cmake
+# Each must be rejected from its header, before the counts are allocated for,
+# and report the rejection in the stats.
+
+set(header "***************m3d-File-Header***************\n")
+
+# Four hundred million materials in a file of a few hundred bytes.
+file(WRITE ${WORK}/materials.m3d "${header}#Materials 400000000\n#Vertices 3\n#Triangles 1\n#Bones 0\n#AnimationClips 0\n")
+
+# Four billion vertices and a billion triangles.
+file(WRITE ${WORK}/vertices.m3d "${header}#Materials 1\n#Vertices 4000000000\n#Triangles 1000000000\n#Bones 0\n#AnimationClips 0\n")
+
+foreach(model materials vertices)
+	execute_process(COMMAND ${CONVERTER} --stats ${WORK}/${model}.json ${WORK}/${model}.m3d
+		RESULT_VARIABLE result OUTPUT_VARIABLE output TIMEOUT 10)
+	if(result EQUAL 0)
+		message(FATAL_ERROR "${model}.m3d converted:\n${output}")
+	endif()
+	if(NOT output MATCHES "Arena high-water mark: [0-9]+ bytes")
+		message(FATAL_ERROR "${model}.m3d did not finish:\n${output}")
+	endif()
+	string(REGEX REPLACE ".*Arena high-water mark: ([0-9]+) bytes.*" "\\1" used "${output}")
+	if(used GREATER 65536)
+		message(FATAL_ERROR "${model}.m3d allocated ${used} bytes before it was rejected")
+	endif()
+
+	file(READ ${WORK}/${model}.json stats)
+	if(NOT stats MATCHES "\"impossible_counts\": 1}")
+		message(FATAL_ERROR "${model}.m3d did not report its counts:\n${stats}")
+	endif()
+endforeach()
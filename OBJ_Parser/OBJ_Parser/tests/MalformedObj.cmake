@@ -0,0 +1,29 @@
+# Converts OBJ files with faces the parser can not read, run by ctest as
+#   cmake -DCONVERTER=<OBJ_Parser> -DWORK=<directory> -P MalformedObj.cmake
+# Each must convert within the timeout, keep its one good triangle and report
+# the bad face in the stats instead of hanging on the failed stream.
+
+# Letters where the corner indices should be.
+file(WRITE ${WORK}/letters.obj "v 0 0 0\nv 1 0 0\nv 0 1 0\nf a b c\nf 1 2 3\n")
+
+# A face with two corners, followed by the vertex its third should have been.
+file(WRITE ${WORK}/short.obj "v 0 0 0\nv 1 0 0\nf 1 2\nv 0 1 0\nf 1 2 3\n")
+
+# A hexagon whose last corner names no vertex, past the four a quad holds.
+file(WRITE ${WORK}/hexagon.obj "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\nv 2 1 0\nf 1 2 4 5 3 9\nf 1 2 3\n")
+
+foreach(model letters short hexagon)
+	execute_process(COMMAND ${CONVERTER} --stats ${WORK}/${model}.json ${WORK}/${model}.obj
+		RESULT_VARIABLE result OUTPUT_VARIABLE output TIMEOUT 10)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "${model}.obj did not convert: ${result}")
+	endif()
+	if(NOT output MATCHES "Indices:  3\n")
+		message(FATAL_ERROR "${model}.obj did not keep its good triangle:\n${output}")
+	endif()
+
+	file(READ ${WORK}/${model}.json stats)
+	if(NOT stats MATCHES "\"bad_indices\": 1,")
+		message(FATAL_ERROR "${model}.obj did not report its bad face:\n${stats}")
+	endif()
+endforeach()
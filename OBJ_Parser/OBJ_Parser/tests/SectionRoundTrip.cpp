@@ -0,0 +1,180 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: SectionRoundTrip.cpp
+// Writes meshes as .smf with raw and with packed sections, reads them back
+// with ReadSMF() and the streaming loader and checks the vertices and indices
+// come back byte for byte.
+//
+// Usage: SectionRoundTrip [model files...]
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ModelParser.h"
+#include "SMFStreamLoader.h"
+using namespace std;
+
+
+/////////////
+// GLOBALS //
+/////////////
+Arena g_TestArena;
+
+
+// Follows the ranges the streaming loader hands out. They have to come in
+// file order and only refer to indices that match the mesh.
+struct StreamCheck
+{
+	const Mesh* mesh;
+	ULONG nextFace;
+	bool matches;
+};
+
+
+static void CheckRange(const SMFView& view, const SubsetTableDesc& range, void* user)
+{
+	StreamCheck* check = (StreamCheck*)user;
+	if (range.FaceStart != check->nextFace || memcmp(view.Indices + (size_t)range.FaceStart * 3, check->mesh->Indices + (size_t)range.FaceStart * 3, sizeof(ULONG) * 3 * range.FaceCount) != 0)
+	{
+		check->matches = false;
+	}
+	check->nextFace = range.FaceStart + range.FaceCount;
+}
+
+
+// A mesh of count vertices and indices filled by the given generators, with
+// enough of both to span several packed chunks.
+template <typename VertexFill, typename IndexFill>
+static Mesh MakeMesh(ULONG vertexCount, ULONG indexCount, VertexFill vertexFill, IndexFill indexFill)
+{
+	Mesh mesh = {};
+	mesh.VertexCount = vertexCount;
+	mesh.IndexCount = indexCount;
+	mesh.Vertices = g_TestArena.NewArray<vertexData>(vertexCount);
+	mesh.Indices = g_TestArena.NewArray<ULONG>(indexCount);
+	for (ULONG i = 0; i < vertexCount; i++)
+	{
+		vertexFill(i, mesh.Vertices[i]);
+	}
+	for (ULONG i = 0; i < indexCount; i++)
+	{
+		mesh.Indices[i] = indexFill(i) % vertexCount;
+	}
+	return mesh;
+}
+
+
+static bool RoundTrip(const string& name, const Mesh& mesh)
+{
+	bool result = true;
+	const UINT flags[2] = { 0, SMF_WRITE_COMPRESS };
+	for (int f = 0; f < 2; f++)
+	{
+		const char* encoding = flags[f] ? "packed" : "raw";
+
+		ostringstream out(ios_base::binary);
+		if (!WriteSMF(mesh, out, flags[f], &g_TestArena))
+		{
+			cout << name << " (" << encoding << "): could not be written" << endl;
+			result = false;
+			continue;
+		}
+
+		string file = out.str();
+		SMFView view;
+		if (!ReadSMF(file.data(), file.size(), g_TestArena, view))
+		{
+			cout << name << " (" << encoding << "): could not be read" << endl;
+			result = false;
+			continue;
+		}
+
+		if (view.Head->VertexCount != mesh.VertexCount || view.Head->IndexCount != mesh.IndexCount ||
+			memcmp(view.Vertices, mesh.Vertices, sizeof(vertexData) * mesh.VertexCount) != 0 ||
+			memcmp(view.Indices, mesh.Indices, sizeof(ULONG) * mesh.IndexCount) != 0)
+		{
+			cout << name << " (" << encoding << "): sections differ after reading back" << endl;
+			result = false;
+			continue;
+		}
+
+		// The streaming loader reads from a file.
+		const char* tempFile = "SectionRoundTrip.tmp.smf";
+		ofstream temp(tempFile, ios_base::binary);
+		temp.write(file.data(), file.size());
+		temp.close();
+
+		SMFStreamLoader loader;
+		StreamCheck check = { &mesh, 0, true };
+		bool streamed = loader.Start(tempFile, g_TestArena) && loader.Finish(CheckRange, &check, view);
+		remove(tempFile);
+		if (!streamed || !check.matches || check.nextFace != mesh.IndexCount / 3 ||
+			memcmp(view.Vertices, mesh.Vertices, sizeof(vertexData) * mesh.VertexCount) != 0)
+		{
+			cout << name << " (" << encoding << "): sections differ after streaming back" << endl;
+			result = false;
+			continue;
+		}
+
+		cout << name << " (" << encoding << "): " << file.size() << " bytes" << endl;
+	}
+
+	return result;
+}
+
+
+int main(int argc, char* argv[])
+{
+	bool result = true;
+	mt19937 random(1234);
+
+	// Random bits leave nothing to compress, so chunks are stored.
+	result &= RoundTrip("noise", MakeMesh(10000, 70000,
+		[&](ULONG, vertexData& v) { for (size_t k = 0; k < sizeof(v) / 4; k++) { ((std::uint32_t*)&v)[k] = random(); } },
+		[&](ULONG) { return (ULONG)random(); }));
+
+	// One value everywhere, so every plane is constant.
+	result &= RoundTrip("constant", MakeMesh(9000, 40000,
+		[](ULONG, vertexData& v) { v.pos = v.Normal = DirectX::XMFLOAT3(1.0f, 2.0f, 3.0f); v.tex = DirectX::XMFLOAT2(0.5f, 0.5f); v.ID = 7; },
+		[](ULONG) { return (ULONG)3; }));
+
+	// A smooth surface, where the planes are skewed and the codes are used.
+	result &= RoundTrip("surface", MakeMesh(12000, 66000,
+		[](ULONG i, vertexData& v) {
+			float x = (float)(i % 100), z = (float)(i / 100);
+			v.pos = DirectX::XMFLOAT3(x, sinf(x * 0.1f) * cosf(z * 0.1f), z);
+			v.Normal = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+			v.tex = DirectX::XMFLOAT2(x / 100.0f, z / 120.0f);
+			v.ID = i / 4000;
+		},
+		[](ULONG i) { return (ULONG)(i / 6 + i % 3 * 100); }));
+
+	// A single vertex and triangle.
+	result &= RoundTrip("tiny", MakeMesh(1, 3,
+		[](ULONG, vertexData& v) { v.pos = v.Normal = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f); v.tex = DirectX::XMFLOAT2(0.0f, 0.0f); v.ID = 0; },
+		[](ULONG) { return (ULONG)0; }));
+
+	for (int i = 1; i < argc; i++)
+	{
+		Mesh mesh;
+		if (!LoadModel(argv[i], g_TestArena, mesh))
+		{
+			cout << argv[i] << ": could not be loaded" << endl;
+			result = false;
+			continue;
+		}
+		result &= RoundTrip(argv[i], mesh);
+	}
+
+	return result ? 0 : -1;
+}